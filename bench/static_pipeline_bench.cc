@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Filename:    static_pipeline_bench.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+// Measures what the dynamic pipeline's flexibility costs: the same source,
+// stages and sink run once through shared_ptrs and virtual calls, as
+// LinearPipeline does, and once as a StaticPipeline. Small frames show the
+// per-frame dispatch overhead, large frames show how much of it is left once
+// real pixel work dominates.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "colorspace_transformer.h"
+#include "opencv2/core.hpp"
+#include "static_pipeline.h"
+#include "threshold_transformer.h"
+#include "timing.h"
+#include "video_consumer.h"
+#include "video_source.h"
+#include "video_transformer.h"
+
+namespace {
+
+class SyntheticSource final : public VideoSource {
+   public:
+    SyntheticSource(int width, int height) : frame_(height, width, CV_8UC3) {
+        cv::randu(frame_, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+    void Open() override {}
+    void Close() override {}
+    void ReadFrame(cv::Mat& frame) override { frame_.copyTo(frame); }
+
+   private:
+    cv::Mat frame_;
+};
+
+class NullSink final : public VideoConsumer {
+   public:
+    void Consume(const cv::Mat& frame) override { frames_++; }
+    std::uint64_t frames_ = 0;
+};
+
+using BenchPipeline =
+    StaticPipeline<SyntheticSource, BypassTransformer, BypassTransformer,
+                   ThresholdTransformer, BypassTransformer, NullSink>;
+
+void Run(int width, int height, int iterations) {
+    // Dynamic: the frame path of LinearPipeline
+    std::shared_ptr<VideoSource> source =
+        std::make_shared<SyntheticSource>(width, height);
+    std::vector<std::shared_ptr<VideoTransformer>> stages = {
+        std::make_shared<BypassTransformer>(),
+        std::make_shared<BypassTransformer>(),
+        std::make_shared<ThresholdTransformer>(127.0f, 1.0f),
+        std::make_shared<BypassTransformer>(),
+    };
+    std::vector<std::shared_ptr<VideoConsumer>> sinks = {
+        std::make_shared<NullSink>(),
+    };
+    cv::Mat frame;
+    auto dynamic_time = TimeFunction([&] {
+        for (int i = 0; i < iterations; i++) {
+            source->ReadFrame(frame);
+            for (auto& stage : stages) {
+                stage->Transform(frame);
+            }
+            for (auto& sink : sinks) {
+                sink->Consume(frame);
+            }
+        }
+    });
+
+    std::atomic<bool> shutting_down(false);
+    BenchPipeline pipeline(
+        TaskId::VIDEO_PROCESSING, TaskPriority::VIDEO_PROCESSING,
+        TaskUpdatePeriodMs(0), shutting_down,
+        SyntheticSource(width, height), BypassTransformer(),
+        BypassTransformer(), ThresholdTransformer(127.0f, 1.0f),
+        BypassTransformer(), NullSink());
+    cv::Mat static_frame;
+    auto static_time = TimeFunction([&] {
+        for (int i = 0; i < iterations; i++) {
+            pipeline.RunFrame(static_frame);
+        }
+    });
+
+    std::printf("%5dx%-5d dynamic %10.3f us/frame  static %10.3f us/frame  "
+                "overhead %6.2f%%\n",
+                width, height, dynamic_time / iterations * 1.0e6,
+                static_time / iterations * 1.0e6,
+                100.0 * (dynamic_time - static_time) / static_time);
+}
+
+}  // namespace
+
+int main() {
+    Run(16, 16, 200000);
+    Run(320, 240, 20000);
+    Run(1920, 1080, 500);
+    return 0;
+}
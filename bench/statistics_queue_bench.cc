@@ -0,0 +1,159 @@
+/******************************************************************************
+ * Filename:    statistics_queue_bench.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+// Checks StatisticsQueue against a naive recomputation over the same window on
+// random and adversarial sequences, then measures Push() and GetStatistics(),
+// with and without a reader polling from another thread. Exits non-zero if
+// any statistic disagrees with the reference.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "statistics.h"
+#include "timing.h"
+
+namespace {
+
+constexpr int kPushes = 5000000;
+constexpr int kReads = 1000000;
+
+Statistics<double> Reference(const std::deque<double>& window) {
+    Statistics<double> statistics{0, 0, 0, 0, 0};
+    if (window.empty()) {
+        return statistics;
+    }
+    statistics.minimum = *std::min_element(window.begin(), window.end());
+    statistics.maximum = *std::max_element(window.begin(), window.end());
+    double sum = 0.0;
+    for (auto value : window) {
+        sum += value;
+    }
+    statistics.average = sum / window.size();
+    double m2 = 0.0;
+    for (auto value : window) {
+        m2 += (value - statistics.average) * (value - statistics.average);
+    }
+    statistics.variance = m2 / window.size();
+    return statistics;
+}
+
+bool Close(double actual, double expected) {
+    return std::fabs(actual - expected) <=
+           1.0e-9 * std::fabs(expected) + 1.0e-12;
+}
+
+// Pushes the sequence and compares every snapshot with the reference
+bool Check(const char* name, std::size_t window_size,
+           const std::vector<double>& values) {
+    StatisticsQueue<double> queue(window_size);
+    std::deque<double> window;
+    for (std::size_t i = 0; i < values.size(); i++) {
+        queue.Push(values[i]);
+        window.push_back(values[i]);
+        if (window.size() > window_size) {
+            window.pop_front();
+        }
+        auto actual = queue.GetStatistics();
+        auto expected = Reference(window);
+        if (actual.minimum != expected.minimum ||
+            actual.maximum != expected.maximum ||
+            !Close(actual.average, expected.average) ||
+            !Close(actual.variance, expected.variance)) {
+            std::printf(
+                "FAIL %s window %zu after %zu pushes: min %g/%g max %g/%g "
+                "avg %g/%g var %g/%g\n",
+                name, window_size, i + 1, actual.minimum, expected.minimum,
+                actual.maximum, expected.maximum, actual.average,
+                expected.average, actual.variance, expected.variance);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckProperties() {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> small(0, 3);
+    bool ok = true;
+    for (std::size_t window_size : {1, 2, 3, 7, 100, 257}) {
+        std::vector<double> random, duplicates, rising, falling, offset;
+        for (int i = 0; i < 5000; i++) {
+            random.push_back(uniform(rng));
+            duplicates.push_back(small(rng));
+            rising.push_back(i);
+            falling.push_back(-i);
+            // Large mean, tiny spread: the case naive sum of squares loses
+            offset.push_back(1.0e6 + uniform(rng) * 1.0e-3);
+        }
+        ok &= Check("random", window_size, random);
+        ok &= Check("duplicates", window_size, duplicates);
+        ok &= Check("rising", window_size, rising);
+        ok &= Check("falling", window_size, falling);
+        ok &= Check("offset", window_size, offset);
+    }
+    return ok;
+}
+
+void Report(const char* name, double seconds, int operations) {
+    std::printf("%-24s %8.2f ns/op\n", name, seconds / operations * 1.0e9);
+}
+
+}  // namespace
+
+int main() {
+    if (!CheckProperties()) {
+        return 1;
+    }
+    std::printf("all windows match the reference\n");
+
+    std::vector<double> values(4096);
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> uniform(0.0, 0.05);
+    for (auto& value : values) {
+        value = uniform(rng);
+    }
+
+    StatisticsQueue<double> queue(100);
+    Report("Push", TimeFunction([&] {
+               for (int i = 0; i < kPushes; i++) {
+                   queue.Push(values[i & 4095]);
+               }
+           }),
+           kPushes);
+
+    double sink = 0.0;
+    Report("GetStatistics", TimeFunction([&] {
+               for (int i = 0; i < kReads; i++) {
+                   sink += queue.GetStatistics().average;
+               }
+           }),
+           kReads);
+
+    // A reader polling as fast as it can costs the writer cache traffic, but
+    // never a wait
+    std::atomic<bool> done(false);
+    std::thread reader([&] {
+        while (!done) {
+            sink += queue.GetStatistics().maximum;
+        }
+    });
+    Report("Push with reader", TimeFunction([&] {
+               for (int i = 0; i < kPushes; i++) {
+                   queue.Push(values[i & 4095]);
+               }
+           }),
+           kPushes);
+    done = true;
+    reader.join();
+    std::printf("checksum %g\n", sink);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Filename:    shm_frame_reader_example.cc
+ * Description: Example of a downstream process reading frames published by
+ *              spp_app ('output shm'). Frames are used directly in shared
+ *              memory; wrap them with
+ *                  cv::Mat(view.rows, view.cols, view.type,
+ *                          const_cast<uint8_t*>(view.data), view.step)
+ *              to hand them to OpenCV without a copy.
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+#include "error_handling.h"
+#include "shm_frame_reader.h"
+
+std::atomic<bool> shutting_down(false);
+
+void SignalHandler(int signum) {
+    if (signum == SIGINT || signum == SIGTERM) {
+        shutting_down = true;
+    }
+}
+
+// Stand-in for real analytics: average intensity of the frame
+double AverageIntensity(const ShmFrameView& view) {
+    std::uint64_t sum = 0;
+    auto row_size = static_cast<std::uint64_t>(view.size / view.rows);
+    for (std::int32_t row = 0; row < view.rows; row++) {
+        const std::uint8_t* pixels = view.data + row * view.step;
+        for (std::uint64_t i = 0; i < row_size; i++) {
+            sum += pixels[i];
+        }
+    }
+    return static_cast<double>(sum) / static_cast<double>(view.size);
+}
+
+int main(int argc, char* argv[]) {
+    std::signal(SIGINT, SignalHandler);
+    std::signal(SIGTERM, SignalHandler);
+
+    ShmFrameReader reader(argc > 1 ? argv[1] : kShmFrameRingDefaultName);
+    ShmFrameView view;
+    std::uint64_t frames_torn = 0;
+
+    try {
+        while (!shutting_down) {
+            if (!reader.IsOpen() && !reader.Open()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                continue;
+            }
+            if (!reader.AcquireLatest(view)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            auto intensity = AverageIntensity(view);
+
+            // Only trust the result if the publisher did not overwrite the
+            // slot while we were reading it
+            if (!reader.IsValid(view)) {
+                frames_torn++;
+                continue;
+            }
+
+            auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now()
+                                  .time_since_epoch())
+                              .count();
+            std::cout << "frame " << view.sequence << " " << view.cols << "x"
+                      << view.rows << " type " << view.type << " intensity "
+                      << intensity << " latency "
+                      << (now_ns - view.timestamp_ns) * 1.0e-6 << " ms"
+                      << " skipped " << reader.frames_skipped() << " torn "
+                      << frames_torn << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
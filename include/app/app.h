@@ -8,12 +8,20 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "colorspace_transformer.h"
 #include "diagnostics.h"
+#include "graph_pipeline.h"
 #include "haar_cascade_classifier.h"
+#include "metrics_exporter.h"
+#include "pipeline_manager.h"
+#include "profiled_mutex.h"
+#include "rate_limiter.h"
 #include "task.h"
 #include "video_consumer.h"
 #include "video_input.h"
@@ -29,8 +37,8 @@ class App {
     ~App();
     void Init();
     void Shutdown();
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    ProfiledMutex mutex_{"app"};
+    ProfiledConditionVariable cond_{"app"};
 
    private:
     static void TaskFcn(Task* task);
@@ -38,6 +46,30 @@ class App {
     void ParseTokens(std::vector<std::string>& tokens);
     void ParseInputTokens(std::vector<std::string>& tokens);
     void ParseProcessingTokens(std::vector<std::string>& tokens);
+    void ParseOutputTokens(std::vector<std::string>& tokens);
+    void ParsePipelineTokens(std::vector<std::string>& tokens);
+    void ParseMetricsTokens(std::vector<std::string>& tokens);
+    void ParseTraceTokens(std::vector<std::string>& tokens);
+    void ParseFlightTokens(std::vector<std::string>& tokens);
+    void ParsePerfTokens(std::vector<std::string>& tokens);
+    std::shared_ptr<VideoSourceFactory> ParseSourceTokens(
+        std::vector<std::string>& tokens);
+    std::shared_ptr<VideoTransformerFactory> ParseTransformerTokens(
+        std::vector<std::string>& tokens);
+    std::shared_ptr<VideoTransformerFactory> ParseTransformerChainTokens(
+        std::vector<std::string>& tokens);
+    std::shared_ptr<VideoTransformerFactory> ParseRoiTokens(
+        std::vector<std::string>& tokens);
+    std::shared_ptr<VideoConsumerFactory> ParseConsumerTokens(
+        const std::string& output_type, std::vector<std::string>& tokens,
+        const std::string& window_name);
+    bool ParsePeriodTokens(std::vector<std::string>& tokens,
+                           TaskUpdatePeriodMs& period_ms);
+    bool ParseRateTokens(std::vector<std::string>& tokens, RateLimit& limit);
+    void CreateGraphPipeline(const std::string& name,
+                             const std::string& filename,
+                             TaskUpdatePeriodMs period_ms);
+    std::shared_ptr<LinearPipeline> FindLinearPipeline(const std::string& name);
     void Throttle();
     void Help();
     void Help(const std::string help_type);
@@ -45,10 +77,10 @@ class App {
     void Pause();
     void Stop();
     void PrintStats();
-    void SetSourceWebcam();
-    void SetSourceVideoFile(const std::string filename);
-    void SetTransformerColorspace(Colorspace colorspace);
-    void SetTrasformerHaarCascadeClassifier(HaarCascadeClassifierType type);
+    void AddOutput(const std::string& output_type,
+                   std::shared_ptr<VideoConsumerFactory> consumer_factory);
+    void RemoveOutput(const std::string& output_type);
+    void ListPipelines();
     void Quit();
     Task task_;
     std::atomic<bool>& shutting_down_;
@@ -56,7 +88,10 @@ class App {
     VideoInput video_input_;
     VideoProcessor video_processor_;
     VideoOutput video_output_;
+    std::map<std::string, std::shared_ptr<VideoConsumer>> outputs_;
+    PipelineManager pipeline_manager_;
     Diagnostics diagnostics_;
+    std::unique_ptr<MetricsExporter> metrics_exporter_;
 };
 
 #endif  // APP_H
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Filename:    shm_frame_reader.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef SHM_FRAME_READER_H
+#define SHM_FRAME_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "shm_frame_ring.h"
+
+// A frame that lives directly in shared memory. The pixel data is only
+// guaranteed to be intact if ShmFrameReader::IsValid() still returns true
+// after the caller is done with it.
+struct ShmFrameView {
+    const std::uint8_t* data = nullptr;
+    std::uint64_t sequence = 0;
+    std::int64_t timestamp_ns = 0;
+    std::uint64_t size = 0;
+    std::uint64_t step = 0;
+    std::int32_t rows = 0;
+    std::int32_t cols = 0;
+    std::int32_t type = 0;
+
+   private:
+    friend class ShmFrameReader;
+    const ShmFrameSlotHeader* slot_ = nullptr;
+    std::uint64_t seqlock_ = 0;
+};
+
+// Attaches read-only to a frame ring published by ShmFramePublisher. Any
+// number of readers may attach to the same ring; none of them copy frames.
+class ShmFrameReader {
+   public:
+    explicit ShmFrameReader(const std::string& name = kShmFrameRingDefaultName)
+        : name_(name) {}
+    ~ShmFrameReader();
+    // False until the publisher has created the ring; throws if the ring has
+    // a layout this reader doesn't understand
+    bool Open();
+    void Close();
+    bool IsOpen() const { return ring_ != nullptr; }
+    bool AcquireLatest(ShmFrameView& view);
+    bool IsValid(const ShmFrameView& view) const;
+    std::uint64_t frames_skipped() const { return frames_skipped_; }
+    // Of the ring that is open; changes when a reopen finds a new ring
+    std::uint32_t generation() const { return generation_; }
+
+   private:
+    std::string name_;
+    ShmFrameRingHeader* ring_ = nullptr;
+    std::size_t mapped_size_ = 0;
+    std::uint64_t last_sequence_ = 0;
+    std::uint64_t frames_skipped_ = 0;
+    std::uint32_t generation_ = 0;
+};
+
+#endif  // SHM_FRAME_READER_H
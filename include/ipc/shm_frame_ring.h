@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Filename:    shm_frame_ring.h
+ * Description: Memory layout of the shared-memory frame ring that is written
+ *              by ShmFramePublisher and read by ShmFrameReader. The segment
+ *              starts with a ShmFrameRingHeader followed by slot_count slots,
+ *              each made of a ShmFrameSlotHeader and slot_capacity bytes of
+ *              pixel data.
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef SHM_FRAME_RING_H
+#define SHM_FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+constexpr std::uint32_t kShmFrameRingMagic = 0x46505053;  // "SPPF"
+constexpr std::uint32_t kShmFrameRingVersion = 1;
+constexpr std::size_t kShmFrameRingAlignment = 64;
+constexpr const char* kShmFrameRingDefaultName = "/spp_frames";
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "The frame ring needs address-free 64-bit atomics");
+
+struct alignas(kShmFrameRingAlignment) ShmFrameRingHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    // Counts the rings the publisher has created under this name; a ring is
+    // replaced when frames outgrow its slots
+    std::uint32_t generation;
+    std::uint64_t slot_capacity;
+    std::uint64_t slot_stride;
+    // Sequence number of the most recently completed frame (0 = none yet)
+    std::atomic<std::uint64_t> latest_sequence;
+};
+
+// The seqlock is odd while the publisher is writing the slot. A reader that
+// observes the same even value before and after using the slot knows that the
+// header fields and pixel data it saw were not overwritten.
+struct alignas(kShmFrameRingAlignment) ShmFrameSlotHeader {
+    std::atomic<std::uint64_t> seqlock;
+    std::uint64_t sequence;
+    // CLOCK_MONOTONIC, shared by all processes on the host
+    std::int64_t timestamp_ns;
+    std::uint64_t size;
+    std::uint64_t step;
+    std::int32_t rows;
+    std::int32_t cols;
+    // OpenCV type of the frame (e.g. CV_8UC3)
+    std::int32_t type;
+};
+
+inline std::size_t ShmFrameRingAlign(std::size_t size) {
+    return (size + kShmFrameRingAlignment - 1) & ~(kShmFrameRingAlignment - 1);
+}
+
+inline std::size_t ShmFrameRingSlotStride(std::size_t slot_capacity) {
+    return sizeof(ShmFrameSlotHeader) + ShmFrameRingAlign(slot_capacity);
+}
+
+inline std::size_t ShmFrameRingSize(std::uint32_t slot_count,
+                                    std::size_t slot_capacity) {
+    return sizeof(ShmFrameRingHeader) +
+           slot_count * ShmFrameRingSlotStride(slot_capacity);
+}
+
+inline ShmFrameSlotHeader* ShmFrameRingSlot(ShmFrameRingHeader* ring,
+                                            std::uint64_t sequence) {
+    auto* base = reinterpret_cast<std::uint8_t*>(ring) + sizeof(*ring);
+    auto index = (sequence - 1) % ring->slot_count;
+    return reinterpret_cast<ShmFrameSlotHeader*>(base +
+                                                 index * ring->slot_stride);
+}
+
+inline std::uint8_t* ShmFrameRingSlotData(ShmFrameSlotHeader* slot) {
+    return reinterpret_cast<std::uint8_t*>(slot) + sizeof(*slot);
+}
+
+#endif  // SHM_FRAME_RING_H
@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Filename:    graph_pipeline.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef GRAPH_PIPELINE_H
+#define GRAPH_PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "pipeline.h"
+#include "pipeline_graph.h"
+#include "source_reader.h"
+#include "statistics.h"
+#include "video_consumer.h"
+#include "video_source.h"
+#include "video_transformer.h"
+
+// Turns the tokens of a node into a component factory. A null factory means
+// the tokens were invalid.
+struct PipelineNodeFactories {
+    std::function<std::shared_ptr<VideoSourceFactory>(
+        std::vector<std::string>&)>
+        source;
+    std::function<std::shared_ptr<VideoTransformerFactory>(
+        std::vector<std::string>&)>
+        transformer;
+    std::function<std::shared_ptr<VideoConsumerFactory>(
+        std::vector<std::string>&)>
+        consumer;
+};
+
+// Runs a pipeline graph. Every node is its own work item, so independent
+// branches run concurrently on the worker pool. A node's frame is shared by
+// reference with its sinks and joins, which only read it; its transform
+// branches run once the readers are done, and only the last of them gets the
+// frame itself, the others get a copy. A join places its inputs side by side.
+class GraphPipeline : public Pipeline {
+   public:
+    GraphPipeline(const PipelineName& name, const PipelineGraphConfig& config,
+                  const PipelineNodeFactories& factories,
+                  TaskUpdatePeriodMs period_ms);
+    ~GraphPipeline() override;
+    void DispatchFrame(SchedulerClock::time_point deadline,
+                       WorkerPool& worker_pool) override;
+
+   protected:
+    void OpenSources() override;
+    void ReportComponentDiagnostics(const std::string& prefix,
+                                    DiagnosticsReport& report) override;
+
+   private:
+    struct Node {
+        PipelineNodeType type;
+        std::string name;
+        std::vector<std::size_t> inputs;
+        std::vector<std::size_t> sinks;
+        std::vector<std::size_t> transforms;
+        std::vector<std::size_t> joins;
+        std::shared_ptr<SourceReader> reader;
+        std::shared_ptr<VideoTransformer> transformer;
+        std::shared_ptr<VideoConsumer> consumer;
+        // Only one frame is in flight, so a node can reuse its buffer
+        cv::Mat buffer;
+        std::unique_ptr<StatisticsQueue<double>> time_stats;
+    };
+    struct FrameRun;
+    void Submit(const std::shared_ptr<FrameRun>& run, std::size_t index,
+                cv::Mat frame);
+    void Release(const std::shared_ptr<FrameRun>& run);
+    void RunNode(const std::shared_ptr<FrameRun>& run, std::size_t index,
+                 cv::Mat& frame);
+    void ShedNode(const std::shared_ptr<FrameRun>& run, std::size_t index,
+                  cv::Mat& frame);
+    void Emit(const std::shared_ptr<FrameRun>& run, std::size_t index,
+              cv::Mat& frame);
+    void ReaderDone(const std::shared_ptr<FrameRun>& run, std::size_t index,
+                    cv::Mat& frame);
+    void DispatchWriters(const std::shared_ptr<FrameRun>& run,
+                         std::size_t index, cv::Mat& frame);
+    void ComposeJoin(const std::shared_ptr<FrameRun>& run, std::size_t index);
+    std::vector<Node> nodes_;
+    std::vector<std::size_t> sources_;
+    WorkerPool* worker_pool_;
+    std::atomic<std::uint64_t> branches_shed_;
+};
+
+#endif  // GRAPH_PIPELINE_H
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Filename:    linear_pipeline.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef LINEAR_PIPELINE_H
+#define LINEAR_PIPELINE_H
+
+#include <memory>
+#include <vector>
+
+#include "frame_views.h"
+#include "opencv2/core.hpp"
+#include "pipeline.h"
+#include "source_reader.h"
+#include "video_consumer.h"
+#include "video_source.h"
+#include "video_transformer.h"
+
+// A source, a transformer and any number of consumers. The source is read on
+// its own reader thread, then the rest of each frame runs as a single work
+// item.
+class LinearPipeline : public Pipeline {
+   public:
+    LinearPipeline(const PipelineName& name,
+                   std::shared_ptr<VideoSourceFactory> source_factory,
+                   std::shared_ptr<VideoTransformerFactory> transformer_factory,
+                   TaskUpdatePeriodMs period_ms);
+    ~LinearPipeline() override;
+    void ChangeSource(std::shared_ptr<VideoSourceFactory> new_source_factory);
+    void ChangeTransformer(
+        std::shared_ptr<VideoTransformerFactory> new_transformer_factory);
+    std::shared_ptr<VideoConsumer> AddConsumer(
+        std::shared_ptr<VideoConsumerFactory> consumer_factory);
+    void RemoveConsumers();
+    void DispatchFrame(SchedulerClock::time_point deadline,
+                       WorkerPool& worker_pool) override;
+
+   protected:
+    void OpenSources() override;
+    void ReportComponentDiagnostics(const std::string& prefix,
+                                    DiagnosticsReport& report) override;
+
+   private:
+    void ProcessFrame(SchedulerClock::time_point deadline, cv::Mat& frame);
+    std::shared_ptr<SourceReader> reader_;
+    std::shared_ptr<VideoTransformer> transformer_;
+    std::vector<std::shared_ptr<VideoConsumer>> consumers_;
+    PixelFormat output_format_;
+    FrameViews views_;
+};
+
+#endif  // LINEAR_PIPELINE_H
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Filename:    pipeline.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "diagnostics_report.h"
+#include "edf_scheduler.h"
+#include "profiled_mutex.h"
+#include "statistics.h"
+#include "task.h"
+#include "worker_pool.h"
+
+using PipelineName = std::string;
+using PipelineClock = SchedulerClock;
+
+// One independent stream. PipelineManager decides when a frame is due and the
+// pipeline dispatches the work for that frame onto a shared WorkerPool; the
+// only threads a pipeline owns read its sources. A pipeline never has more
+// than one frame in flight.
+class Pipeline : public std::enable_shared_from_this<Pipeline> {
+   public:
+    Pipeline(const PipelineName& name, TaskUpdatePeriodMs period_ms);
+    virtual ~Pipeline() = default;
+    void Start();
+    void Stop();
+    bool IsRunning() const { return running_; }
+    const PipelineName& Name() const { return name_; }
+    void SetSchedule(const StreamSchedule& schedule);
+    StreamSchedule GetSchedule();
+    bool TryBeginFrame();
+    virtual void DispatchFrame(SchedulerClock::time_point deadline,
+                               WorkerPool& worker_pool) = 0;
+    void ShedFrame();
+    void SkipFrame() { frames_skipped_++; }
+    void ReportDiagnostics(DiagnosticsReport& report);
+    TaskUpdatePeriodMs period_ms_;
+    PipelineClock::time_point next_frame_time_;
+    StatisticsQueue<double> time_stats_{100};
+    StatisticsQueue<double> lateness_stats_{100};
+
+   protected:
+    virtual void OpenSources() = 0;
+    virtual void ReportComponentDiagnostics(const std::string& prefix,
+                                            DiagnosticsReport& report) = 0;
+    void FinishFrame(SchedulerClock::time_point start_time,
+                     SchedulerClock::time_point deadline, bool processed);
+    void AddPrefixedDiagnostics(const std::string& prefix,
+                                const DiagnosticsReport& component_report,
+                                DiagnosticsReport& report);
+    ProfiledMutex mutex_{"pipeline"};
+
+   private:
+    PipelineName name_;
+    StreamSchedule schedule_;
+    std::atomic<bool> running_;
+    std::atomic<bool> frame_in_flight_;
+    std::atomic<std::uint64_t> frames_processed_;
+    std::atomic<std::uint64_t> frames_skipped_;
+    std::atomic<std::uint64_t> frames_empty_;
+    std::atomic<std::uint64_t> frames_shed_;
+    std::atomic<std::uint64_t> deadline_misses_;
+};
+
+#endif  // PIPELINE_H
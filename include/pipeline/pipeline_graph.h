@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Filename:    pipeline_graph.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PIPELINE_GRAPH_H
+#define PIPELINE_GRAPH_H
+
+#include <string>
+#include <vector>
+
+enum class PipelineNodeType {
+    SOURCE,
+    TRANSFORM,
+    JOIN,
+    SINK,
+};
+
+struct PipelineNodeConfig {
+    PipelineNodeType type;
+    std::string name;
+    std::vector<std::string> inputs;
+    // The remaining tokens of the line, in the same syntax as the 'input',
+    // 'processing' and 'output' commands
+    std::vector<std::string> tokens;
+    int line;
+};
+
+// A pipeline graph is described one node per line, '#' starts a comment:
+//
+//   source    <name> <source tokens>
+//   transform <name> <input> <processing tokens>
+//   join      <name> <input>,<input>[,...]
+//   sink      <name> <input> <output type> <output tokens>
+//
+// A node may only take inputs from nodes declared above it, so every graph
+// that loads is acyclic.
+struct PipelineGraphConfig {
+    std::vector<PipelineNodeConfig> nodes;
+};
+
+PipelineGraphConfig LoadPipelineGraphConfig(const std::string& filename);
+
+#endif  // PIPELINE_GRAPH_H
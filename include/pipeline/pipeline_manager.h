@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Filename:    pipeline_manager.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PIPELINE_MANAGER_H
+#define PIPELINE_MANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "diagnostics_report.h"
+#include "linear_pipeline.h"
+#include "pipeline.h"
+#include "profiled_mutex.h"
+#include "task.h"
+#include "worker_pool.h"
+
+// Owns any number of independent pipelines and drives all of them from a
+// single dispatcher task onto a shared, bounded WorkerPool. A pipeline never
+// has more than one frame in flight; a frame that comes due while the previous
+// one is still running is skipped rather than queued. Each frame is submitted
+// with a deadline of its scheduled capture time plus the pipeline's latency
+// budget, so the pool runs the most urgent stream first.
+class PipelineManager {
+   public:
+    PipelineManager(TaskId id, TaskPriority priority,
+                    TaskUpdatePeriodMs period_ms, std::size_t worker_count,
+                    std::atomic<bool>& shutting_down);
+    ~PipelineManager();
+    void Init();
+    void Shutdown();
+    std::shared_ptr<LinearPipeline> Create(
+        const PipelineName& name,
+        std::shared_ptr<VideoSourceFactory> source_factory,
+        std::shared_ptr<VideoTransformerFactory> transformer_factory,
+        TaskUpdatePeriodMs period_ms);
+    bool Add(std::shared_ptr<Pipeline> pipeline);
+    // Building a pipeline opens its sources, so check the name first; Add
+    // still refuses a name taken in the meantime
+    bool Exists(const PipelineName& name);
+    void Destroy(const PipelineName& name);
+    std::shared_ptr<Pipeline> Find(const PipelineName& name);
+    std::vector<std::shared_ptr<Pipeline>> List();
+    void Start(const PipelineName& name);
+    void Stop(const PipelineName& name);
+    void ReportDiagnostics(DiagnosticsReport& report);
+    ProfiledMutex mutex_{"pipeline_manager"};
+    ProfiledConditionVariable cond_{"pipeline_manager"};
+
+   private:
+    static void TaskFcn(Task* task);
+    PipelineClock::time_point DispatchDueFrames();
+    Task task_;
+    WorkerPool worker_pool_;
+    std::map<PipelineName, std::shared_ptr<Pipeline>> pipelines_;
+    std::atomic<bool>& shutting_down_;
+};
+
+#endif  // PIPELINE_MANAGER_H
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Filename:    source_reader.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef SOURCE_READER_H
+#define SOURCE_READER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "opencv2/core.hpp"
+#include "profiled_mutex.h"
+#include "task.h"
+#include "video_source.h"
+
+// Reads one pipeline source on a thread of its own. A capture blocks for up
+// to a camera frame period, so it must not hold a shared pool worker; the
+// reader grabs the frame and hands it to a callback that submits only the
+// processing to the pool.
+class SourceReader : public std::enable_shared_from_this<SourceReader> {
+   public:
+    using FrameCallback = std::function<void(cv::Mat frame)>;
+
+    explicit SourceReader(std::shared_ptr<VideoSource> source);
+    ~SourceReader();
+    // Only the first call starts the thread
+    void Start();
+    // Safe to call from the reader's own callback
+    void Stop();
+    void Open();
+    void Close();
+    // Closes the current source once any read of it is done
+    void SetSource(std::shared_ptr<VideoSource> source);
+    // Reads the next frame and calls back on the reader thread. One request
+    // is outstanding at a time; a request left when the reader stops is
+    // called back with an empty frame, so its owner can finish the frame.
+    void Request(FrameCallback callback);
+
+   private:
+    static void TaskFcn(Task* task);
+    Task task_;
+    // Held while the source is read, so it isn't closed under the read
+    ProfiledMutex source_mutex_{"source_reader_source"};
+    std::shared_ptr<VideoSource> source_;
+    ProfiledMutex mutex_{"source_reader"};
+    ProfiledConditionVariable cond_{"source_reader"};
+    FrameCallback request_;
+    bool started_;
+    std::atomic<bool> stopping_;
+    // Reused while frames keep their size; only one is in flight at a time
+    cv::Mat buffer_;
+};
+
+#endif  // SOURCE_READER_H
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Filename:    static_pipeline.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef STATIC_PIPELINE_H
+#define STATIC_PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <tuple>
+#include <utility>
+
+#include "logger.h"
+#include "opencv2/core.hpp"
+#include "statistics.h"
+#include "task.h"
+#include "video_task.h"
+
+// A pipeline whose topology is fixed at compile time, for deployments that
+// never reconfigure: StaticPipeline<Webcam, BGR2GRAYTransformer, VideoPlayer>.
+// The first type is the source, the last is the sink and the ones between are
+// transformer stages. Every component is held by value and called on its
+// concrete (final) type, so there are no shared_ptr indirections, no virtual
+// calls and no factories on the frame path; the stages inline into one loop.
+//
+// It runs on its own task like VideoInput and publishes every frame as a
+// VideoTask does, so dynamic stages can still listen to it.
+template <typename Source, typename... Rest>
+class StaticPipeline : public VideoTask {
+    static_assert(sizeof...(Rest) >= 1, "a static pipeline needs a sink");
+
+   public:
+    // The arguments, if any, construct the components in order
+    template <typename... Args>
+    StaticPipeline(TaskId id, TaskPriority priority,
+                   TaskUpdatePeriodMs period_ms,
+                   std::atomic<bool>& shutting_down, Args&&... args)
+        : VideoTask(id, priority, period_ms, TaskFcn, shutting_down),
+          components_(std::forward<Args>(args)...),
+          running_(false) {
+        task_.SetData(this);
+    }
+
+    void Start() {
+        std::get<0>(components_).Open();
+        running_ = true;
+    }
+
+    void Stop() { running_ = false; }
+
+    void Shutdown() {
+        running_ = false;
+        VideoTask::Shutdown();
+        std::get<0>(components_).Close();
+    }
+
+    // Reads, transforms and consumes one frame on the calling thread.
+    // Returns false if the source had no frame.
+    bool RunFrame(cv::Mat& frame) {
+        std::get<0>(components_).ReadFrame(frame);
+        if (frame.empty()) {
+            return false;
+        }
+        RunStages(frame, std::make_index_sequence<kStageCount>());
+        std::get<kStageCount + 1>(components_).Consume(frame);
+        return true;
+    }
+
+    template <std::size_t I>
+    auto& Component() {
+        return std::get<I>(components_);
+    }
+
+    StatisticsQueue<double> time_stats_{100};
+
+   private:
+    static constexpr std::size_t kStageCount = sizeof...(Rest) - 1;
+
+    template <std::size_t... I>
+    void RunStages(cv::Mat& frame, std::index_sequence<I...>) {
+        (std::get<I + 1>(components_).Transform(frame), ...);
+    }
+
+    static void TaskFcn(Task* task) {
+        auto* self = static_cast<StaticPipeline*>(task->GetData());
+
+        while (!self->shutting_down_) {
+            if (self->running_) {
+                auto start_time = std::chrono::high_resolution_clock::now();
+                auto frame = self->frame_pool_->Acquire();
+                if (self->RunFrame(frame.Write())) {
+                    auto end_time = std::chrono::high_resolution_clock::now();
+                    auto elapsed_time_ns =
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            end_time - start_time)
+                            .count();
+                    self->time_stats_.Push(
+                        static_cast<double>(elapsed_time_ns) * 1.0e-9);
+                    self->Publish(std::move(frame));
+                    self->NotifyListeners();
+                } else {
+                    spdlog::error("Static pipeline received an empty frame.");
+                }
+            }
+            self->Throttle();
+        }
+        self->NotifyListeners();
+    }
+
+    std::tuple<Source, Rest...> components_;
+    std::atomic<bool> running_;
+};
+
+#endif  // STATIC_PIPELINE_H
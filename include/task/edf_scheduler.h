@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Filename:    edf_scheduler.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef EDF_SCHEDULER_H
+#define EDF_SCHEDULER_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+using WorkItem = std::function<void()>;
+using SchedulerClock = std::chrono::steady_clock;
+using LatencyBudgetMs = std::chrono::milliseconds;
+
+enum class StreamPriority {
+    HIGH,
+    BEST_EFFORT,
+};
+
+// How the scheduler should treat the work of one stream
+struct StreamSchedule {
+    LatencyBudgetMs latency_budget{100};
+    double weight = 1.0;
+    StreamPriority priority = StreamPriority::HIGH;
+};
+
+struct ScheduledWork {
+    WorkItem run;
+    // Called instead of run when the scheduler sheds the work
+    WorkItem shed;
+    SchedulerClock::time_point deadline;
+    StreamPriority priority = StreamPriority::HIGH;
+    double weight = 1.0;
+};
+
+// Orders work by deadline (earliest deadline first). When the most urgent work
+// has already missed its deadline the system is overloaded, and the scheduler
+// sheds late best-effort work, starting with the item whose lateness divided
+// by its stream weight is largest, so that high-priority streams keep their
+// latency. High-priority work is never shed. Not thread safe; WorkerPool
+// serializes access.
+class EdfScheduler {
+   public:
+    void Push(ScheduledWork work);
+    bool Pop(SchedulerClock::time_point now, ScheduledWork& work,
+             std::vector<ScheduledWork>& shed);
+    std::size_t Size() const { return heap_.size(); }
+    bool Empty() const { return heap_.empty(); }
+    void Clear() { heap_.clear(); }
+
+   private:
+    bool ShedMostOverdue(SchedulerClock::time_point now,
+                         std::vector<ScheduledWork>& shed);
+    std::vector<ScheduledWork> heap_;
+};
+
+#endif  // EDF_SCHEDULER_H
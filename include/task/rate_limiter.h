@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Filename:    rate_limiter.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "diagnostics_report.h"
+#include "task.h"
+
+// How often a stage runs relative to the frames it receives: every Nth frame,
+// at most once per period, or both. The defaults run on every frame.
+struct RateLimit {
+    std::uint32_t every_n = 1;
+    std::chrono::microseconds min_period{0};
+};
+
+// Decides, frame by frame, whether a rate limited stage runs. A target rate
+// follows a fixed schedule rather than the time since the last run, so input
+// jitter doesn't push it below the requested rate. Called from one thread.
+class RateLimiter {
+   public:
+    explicit RateLimiter(const RateLimit& limit);
+    bool Admit();
+    const RateLimit& Limit() const { return limit_; }
+    void ReportDiagnostics(const std::string& prefix,
+                           DiagnosticsReport& report);
+
+   private:
+    RateLimit limit_;
+    std::uint64_t frame_count_;
+    std::chrono::steady_clock::time_point next_time_;
+    std::atomic<std::uint64_t> frames_run_;
+    std::atomic<std::uint64_t> frames_skipped_;
+};
+
+#endif  // RATE_LIMITER_H
@@ -6,10 +6,15 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <sys/types.h>
+
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <thread>
 
+#include "diagnostics_report.h"
+
 // Forward declaration of Task class
 class Task;
 
@@ -27,6 +32,15 @@ enum class TaskId {
     VIDEO_INPUT,
     VIDEO_PROCESSING,
     VIDEO_OUTPUT,
+    VIDEO_PLAYER,
+    VIDEO_RECORDER,
+    PIPELINE_MANAGER,
+    WORKER,
+    SOURCE_READER,
+    MJPEG_ENCODER,
+    MJPEG_SERVER,
+    METRICS_EXPORTER,
+    FLIGHT_RECORDER,
 #ifdef DIAGNOSTICS_ENABLED
     DIAGNOSTICS,
 #endif
@@ -41,9 +55,21 @@ enum class TaskPriority {
 #ifdef DIAGNOSTICS_ENABLED
     DIAGNOSTICS,
 #endif
-    
+    VIDEO_PLAYER = VIDEO_OUTPUT,
+    PIPELINE_MANAGER = VIDEO_INPUT,
+    WORKER = VIDEO_PROCESSING,
+    SOURCE_READER = VIDEO_INPUT,
+    // Background work must never preempt the live pipeline
+    VIDEO_RECORDER = APP,
+    MJPEG_ENCODER = APP,
+    MJPEG_SERVER = APP,
+    METRICS_EXPORTER = APP,
+    FLIGHT_RECORDER = APP,
 };
 
+// A lower_case name for metrics and logs, e.g. "video_processing"
+const char* TaskName(TaskId id);
+
 /***********************************************
 Classes
 ***********************************************/
@@ -55,14 +81,24 @@ class Task {
     void Join();
     void* GetData();
     void SetData(void* data);
+    // CPU time, context switches, scheduling policy and run queue wait of
+    // every running task, e.g. "Task video_processing CPU Seconds". Times
+    // are totals since the task started so that any number of readers can
+    // take their own rates, e.g. CPU utilization, from two reports.
+    static void ReportDiagnostics(DiagnosticsReport& report);
     TaskUpdatePeriodMs period_ms_;
 
    private:
+    void ReportThreadDiagnostics(const std::string& prefix,
+                                 DiagnosticsReport& report);
     TaskId id_;
     TaskPriority priority_;
     TaskFunction function_;
     void* data_;
     std::thread thread_;
+    // Kernel thread id, set by the thread once it runs
+    std::atomic<pid_t> tid_;
+    std::chrono::steady_clock::time_point start_time_;
 };
 
 #endif  // TASK_H
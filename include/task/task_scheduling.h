@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Filename:    task_scheduling.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef TASK_SCHEDULING_H
+#define TASK_SCHEDULING_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "task.h"
+
+enum class SchedulingPolicy { OTHER, FIFO, RR, DEADLINE };
+
+// How one kind of task is scheduled. Without a profile a task runs
+// SCHED_FIFO at its TaskPriority on any CPU.
+struct TaskSchedulingProfile {
+    // Empty for any CPU the process may use. Not allowed for DEADLINE, which
+    // the kernel won't pin to fewer CPUs than its root domain.
+    std::vector<int> cpus;
+    SchedulingPolicy policy = SchedulingPolicy::FIFO;
+    // For FIFO and RR; 0 uses the task's TaskPriority
+    int priority = 0;
+    // For OTHER, and what a real-time task falls back to
+    int nice = 0;
+    // For DEADLINE: the task gets runtime of CPU time every period, and must
+    // have it by deadline into the period (the period if zero)
+    std::chrono::microseconds runtime{0};
+    std::chrono::microseconds deadline{0};
+    std::chrono::microseconds period{0};
+};
+
+using TaskSchedulingProfiles = std::map<TaskId, TaskSchedulingProfile>;
+
+// One task per line, '#' starts a comment:
+//
+//   <task name> [cpus=<list>] [policy=other|fifo|rr|deadline]
+//               [priority=<n>] [nice=<n>]
+//               [runtime_us=<n>] [deadline_us=<n>] [period_us=<n>]
+//
+// where the task name is its TaskName(), e.g. video_input, and a CPU list is
+// like 2,4-7.
+TaskSchedulingProfiles LoadTaskSchedulingConfig(const std::string& filename);
+
+// Used by tasks started afterwards
+void SetTaskSchedulingProfiles(const TaskSchedulingProfiles& profiles);
+TaskSchedulingProfile GetTaskSchedulingProfile(TaskId id,
+                                               TaskPriority priority);
+
+// Applies a profile to the calling thread. Whatever the process isn't
+// allowed to do is logged and skipped: a real-time policy falls back to
+// SCHED_OTHER at the profile's nice value, a negative nice to the default,
+// and CPUs outside the process's affinity mask are dropped.
+void ApplyTaskSchedulingProfile(const char* task_name,
+                                const TaskSchedulingProfile& profile);
+
+#endif  // TASK_SCHEDULING_H
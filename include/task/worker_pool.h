@@ -0,0 +1,48 @@
+/******************************************************************************
+ * Filename:    worker_pool.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "diagnostics_report.h"
+#include "edf_scheduler.h"
+#include "profiled_mutex.h"
+#include "task.h"
+
+// A fixed number of worker tasks that execute work items in deadline order
+// (see EdfScheduler). Lets many pipelines share a bounded set of threads
+// instead of owning one thread per stage.
+class WorkerPool {
+   public:
+    WorkerPool(TaskPriority priority, std::size_t worker_count);
+    ~WorkerPool();
+    void Init();
+    void Shutdown();
+    void Submit(WorkItem item);
+    void Submit(ScheduledWork work);
+    std::size_t QueueDepth();
+    std::size_t WorkerCount() const { return workers_.size(); }
+    void ReportDiagnostics(DiagnosticsReport& report);
+
+   private:
+    static void TaskFcn(Task* task);
+    std::vector<std::unique_ptr<Task>> workers_;
+    EdfScheduler scheduler_;
+    std::atomic<std::uint64_t> work_dispatched_;
+    std::atomic<std::uint64_t> work_shed_;
+    ProfiledMutex mutex_{"worker_pool"};
+    ProfiledConditionVariable cond_{"worker_pool"};
+    bool stopping_;
+};
+
+#endif  // WORKER_POOL_H
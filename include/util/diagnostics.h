@@ -13,27 +13,38 @@
 #include <iostream>
 #include <mutex>
 
+#include "diagnostics_report.h"
+#include "metrics.h"
+#include "pipeline_manager.h"
+#include "profiled_mutex.h"
 #include "statistics.h"
 #include "task.h"
 #include "video_input.h"
 #include "video_output.h"
 #include "video_processor.h"
 
+// Registers the application's components with the metrics registry, so their
+// statistics are part of every snapshot, and optionally exports snapshots to
+// a text file once per period.
 class Diagnostics {
    public:
     Diagnostics(TaskId id, TaskPriority priority, TaskUpdatePeriodMs period_ms,
                 VideoInput& video_input, VideoProcessor& video_processor,
-                VideoOutput& video_output, std::atomic<bool>& shutting_down);
+                VideoOutput& video_output, PipelineManager& pipeline_manager,
+                std::atomic<bool>& shutting_down);
     ~Diagnostics();
     void Init() { task_.Start(); }
     void Shutdown() { task_.Join(); }
-    std::mutex mutex;
-    std::condition_variable cond;
+    // Rewrites diagnostics/diagnostics_out.txt every period while enabled
+    bool SetFileOutput(bool enabled);
+    ProfiledMutex mutex{"diagnostics"};
+    ProfiledConditionVariable cond{"diagnostics"};
 
    private:
     const std::string kDiagonsticsFolder = "diagnostics";
     const std::string kDiagonsticsFile =
         kDiagonsticsFolder + "/diagnostics_out.txt";
+    static constexpr std::size_t kDiagnosticsPadding = 256;
     static void TaskFcn(Task* task);
     void CreateDiagnosticsFolder();
     void OpenDiagnosticsFile();
@@ -41,13 +52,16 @@ class Diagnostics {
     void RemoveDiagnosticsFolder();
     void ResetDiagnosticsLog();
     void UpdateDiagnosticsLog();
-    void UpdateStatistics();
+    void CollectReport(DiagnosticsReport& report);
     Task task_;
     VideoInput& video_input_;
     VideoProcessor& video_processor_;
     VideoOutput& video_output_;
+    PipelineManager& pipeline_manager_;
+    MetricsRegistry::CollectorId collector_id_;
+    ProfiledMutex file_mutex_{"diagnostics_file"};
     std::ofstream diagnostics_log_;
-    Statistics<double> video_processing_time_stats_{0, 0, 0, 0, 0};
+    bool file_output_;
     std::atomic<bool>& shutting_down_;
 };
 
@@ -0,0 +1,41 @@
+/******************************************************************************
+ * Filename:    diagnostics_report.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef DIAGNOSTICS_REPORT_H
+#define DIAGNOSTICS_REPORT_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "statistics.h"
+
+// Collects named statistics from pipeline components so that Diagnostics can
+// report them without knowing about every component type.
+struct DiagnosticsReport {
+    void AddTimeStatistics(const std::string& name,
+                           const Statistics<double>& statistics) {
+        time_statistics.emplace_back(name, statistics);
+    }
+    void AddCounter(const std::string& name, std::uint64_t value) {
+        counters.emplace_back(name, value);
+    }
+    // A level or ratio, e.g. instructions per cycle
+    void AddValue(const std::string& name, double value) {
+        values.emplace_back(name, value);
+    }
+    void Clear() {
+        time_statistics.clear();
+        counters.clear();
+        values.clear();
+    }
+
+    std::vector<std::pair<std::string, Statistics<double>>> time_statistics;
+    std::vector<std::pair<std::string, std::uint64_t>> counters;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+#endif  // DIAGNOSTICS_REPORT_H
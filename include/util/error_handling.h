@@ -45,4 +45,32 @@ class DiagnosticsException : public std::exception {
     std::string message_;
 };
 
+class ShmTransportException : public std::exception {
+   public:
+    explicit ShmTransportException(const std::string& msg) : message_(msg) {}
+    const char* what() const noexcept override { return message_.c_str(); }
+
+   private:
+    std::string message_;
+};
+
+class PipelineConfigException : public std::exception {
+   public:
+    explicit PipelineConfigException(const std::string& msg) : message_(msg) {}
+    const char* what() const noexcept override { return message_.c_str(); }
+
+   private:
+    std::string message_;
+};
+
+class SchedulingConfigException : public std::exception {
+   public:
+    explicit SchedulingConfigException(const std::string& msg)
+        : message_(msg) {}
+    const char* what() const noexcept override { return message_.c_str(); }
+
+   private:
+    std::string message_;
+};
+
 #endif  // ERROR_HANDLING_H
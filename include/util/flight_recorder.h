@@ -0,0 +1,113 @@
+/******************************************************************************
+ * Filename:    flight_recorder.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "task.h"
+
+struct FlightRecorderConfig {
+    // Frames of the main pipeline are due this long after capture; pipelines
+    // use the deadlines they are scheduled with
+    std::chrono::milliseconds frame_deadline{33};
+    // How late a frame may be before the ring is dumped
+    std::chrono::milliseconds margin{10};
+    // Misses closer to the last dump than this don't dump again
+    std::chrono::milliseconds min_dump_interval{2000};
+    std::string folder = "flight_recorder";
+};
+
+struct FlightEvent {
+    // Steady clock nanoseconds
+    std::uint64_t time_ns;
+    const char* source;
+    const char* kind;
+    std::uint64_t frame;
+    double value;
+    std::string text;
+};
+
+// Always keeps the last few seconds of frame timings and events (transformer
+// swaps, source changes, drops, logged errors) in a fixed ring, and dumps the
+// ring to a timestamped file in the background whenever a frame misses its
+// deadline by more than the margin. Recording takes a slot with one atomic
+// add and never blocks or allocates, so it stays on in production.
+class FlightRecorder {
+   public:
+    static constexpr std::size_t kCapacity = 1 << 12;
+    static constexpr std::size_t kTextSize = 56;
+
+    static FlightRecorder& instance();
+    ~FlightRecorder();
+
+    // Starts dumping on deadline misses; events are recorded either way
+    void Start(const FlightRecorderConfig& config);
+    void Stop();
+    FlightRecorderConfig Config();
+
+    // source and kind must be string literals; longer text is cut off
+    void Record(const char* source, const char* kind, std::uint64_t frame,
+                double value, std::string_view text = {});
+    void RecordFrame(const char* source, std::uint64_t frame, double seconds) {
+        Record(source, "frame", frame, seconds);
+    }
+    // Records a late frame and requests a dump if it is late by more than
+    // the margin
+    void CheckLateness(const char* source, std::uint64_t frame,
+                       double lateness, std::string_view text = {});
+    std::chrono::milliseconds FrameDeadline() const {
+        return std::chrono::milliseconds(
+            frame_deadline_ms_.load(std::memory_order_relaxed));
+    }
+    // Requests a dump, e.g. from the command line
+    void RequestDump(const std::string& reason);
+
+    // Oldest first
+    std::vector<FlightEvent> Snapshot() const;
+    std::uint64_t Dumps() const { return dumps_; }
+
+   private:
+    using TextWords = std::array<std::atomic<std::uint64_t>,
+                                 kTextSize / sizeof(std::uint64_t)>;
+    // Written under a per slot sequence number: odd while a writer is in it
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<std::uint64_t> time_ns{0};
+        std::atomic<const char*> source{nullptr};
+        std::atomic<const char*> kind{nullptr};
+        std::atomic<std::uint64_t> frame{0};
+        std::atomic<double> value{0.0};
+        TextWords text;
+    };
+
+    FlightRecorder();
+    static void TaskFcn(Task* task);
+    void WriteDump(const std::string& reason);
+    std::vector<Slot> slots_;
+    std::atomic<std::uint64_t> next_;
+    std::atomic<bool> running_;
+    std::atomic<std::int64_t> frame_deadline_ms_;
+    std::atomic<std::int64_t> margin_ns_;
+    std::atomic<bool> dump_requested_;
+    std::atomic<std::uint64_t> dumps_;
+    Task task_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    FlightRecorderConfig config_;
+    std::string dump_reason_;
+    std::chrono::steady_clock::time_point last_dump_time_;
+};
+
+#endif  // FLIGHT_RECORDER_H
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Filename:    metrics.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "diagnostics_report.h"
+
+// Updates from different threads land in different shards, so a hot counter
+// never bounces one cache line between cores
+constexpr std::size_t kMetricShards = 8;
+
+// The shard of the calling thread, assigned round robin on first use
+std::size_t MetricShard();
+
+// A monotonically increasing count, e.g. frames processed. Add() is wait-free.
+class Counter {
+   public:
+    void Add(std::uint64_t value = 1) {
+        shards_[MetricShard()].value.fetch_add(value,
+                                               std::memory_order_relaxed);
+    }
+    std::uint64_t Value() const;
+
+   private:
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> value{0};
+    };
+    std::array<Shard, kMetricShards> shards_;
+};
+
+// A value that goes up and down, e.g. a queue depth. Set() is wait-free.
+class Gauge {
+   public:
+    void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+    double Value() const { return value_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<double> value_{0.0};
+};
+
+struct HistogramSample {
+    // Upper bounds of the buckets; counts has one more entry for +Inf
+    std::vector<double> bounds;
+    std::vector<std::uint64_t> counts;
+    std::uint64_t count = 0;
+    double sum = 0.0;
+    // Upper bound of the bucket holding the q quantile
+    double Quantile(double q) const;
+};
+
+// A distribution of durations in seconds. Observe() is wait-free; the sum is
+// kept in integer nanoseconds so it can be added atomically.
+class Histogram {
+   public:
+    explicit Histogram(std::vector<double> bounds);
+    void Observe(double seconds);
+    HistogramSample Sample() const;
+
+   private:
+    struct alignas(64) Shard {
+        std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+        std::atomic<std::uint64_t> sum_ns{0};
+    };
+    std::vector<double> bounds_;
+    std::array<Shard, kMetricShards> shards_;
+};
+
+// 100 us to 1 s, which covers everything from a conversion to a stalled stage
+std::vector<double> DefaultLatencyBuckets();
+
+struct MetricsSnapshot {
+    std::vector<std::pair<std::string, std::uint64_t>> counters;
+    std::vector<std::pair<std::string, double>> gauges;
+    std::vector<std::pair<std::string, HistogramSample>> histograms;
+    // Statistics reported by collectors, e.g. components that keep a
+    // StatisticsQueue
+    DiagnosticsReport report;
+};
+
+// Process-wide registry of metrics. Components look up their metrics once and
+// keep the returned pointer, so the hot path never touches the registry.
+// Components that already summarize their own state can add a collector
+// instead, which is only called when a snapshot is taken.
+class MetricsRegistry {
+   public:
+    using Collector = std::function<void(DiagnosticsReport&)>;
+    using CollectorId = std::uint64_t;
+
+    static MetricsRegistry& instance();
+
+    // Returns the metric registered under name, creating it on first use
+    std::shared_ptr<Counter> GetCounter(const std::string& name);
+    std::shared_ptr<Gauge> GetGauge(const std::string& name);
+    std::shared_ptr<Histogram> GetHistogram(
+        const std::string& name,
+        std::vector<double> bounds = DefaultLatencyBuckets());
+
+    // Collectors must not call back into the registry
+    CollectorId AddCollector(Collector collector);
+    void RemoveCollector(CollectorId id);
+
+    MetricsSnapshot Snapshot();
+
+   private:
+    MetricsRegistry() = default;
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<Counter>> counters_;
+    std::map<std::string, std::shared_ptr<Gauge>> gauges_;
+    std::map<std::string, std::shared_ptr<Histogram>> histograms_;
+    std::map<CollectorId, Collector> collectors_;
+    CollectorId next_collector_id_ = 0;
+};
+
+// The human readable table used by 'stats' and the diagnostics file
+void WriteMetricsText(const MetricsSnapshot& snapshot, std::ostream& out);
+
+// The Prometheus text exposition format (version 0.0.4). Every name gets the
+// prefix; report names such as "Recorder Frames Dropped" become
+// spp_recorder_frames_dropped, and time statistics become gauges with a stat
+// label. Report counters are exported as untyped since a report does not say
+// whether a counter is a count or a level; report values become gauges.
+void WritePrometheusText(const MetricsSnapshot& snapshot, std::ostream& out,
+                         const std::string& prefix = "spp_");
+
+#endif  // METRICS_H
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Filename:    metrics_exporter.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "metrics.h"
+#include "task.h"
+
+struct MetricsExporterConfig {
+    std::string bind_address = "127.0.0.1";
+    std::uint16_t port = 9464;
+    // Listens on a UNIX socket at this path instead of TCP when set
+    std::string unix_path;
+};
+
+// Serves the metrics registry in the Prometheus text format at /metrics. The
+// exposition is rendered from a fresh snapshot on every scrape, so nothing is
+// collected or formatted while nobody is scraping. Per stage frame rates are
+// the rate() of the <stage>_frames_total counters. Requests are served one at
+// a time on the exporter task, which is plenty for a scraper or two.
+class MetricsExporter {
+   public:
+    explicit MetricsExporter(const MetricsExporterConfig& config);
+    ~MetricsExporter();
+    // Where scrapers can reach the exporter, e.g. http://127.0.0.1:9464/metrics
+    std::string Address() const;
+
+   private:
+    static void TaskFcn(Task* task);
+    void OpenTcpSocket();
+    void OpenUnixSocket();
+    void ServeClient(int socket);
+    std::string Render();
+    MetricsExporterConfig config_;
+    Task task_;
+    int listen_socket_;
+    // Of the UNIX socket this exporter bound, so it only ever removes that
+    bool unix_socket_bound_;
+    dev_t unix_socket_device_;
+    ino_t unix_socket_inode_;
+    std::atomic<bool> stopping_;
+    std::shared_ptr<Counter> scrapes_total_;
+    std::shared_ptr<Histogram> render_histogram_;
+};
+
+#endif  // METRICS_EXPORTER_H
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Filename:    perf_counters.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "diagnostics_report.h"
+#include "statistics.h"
+
+// Counts what a stage does per frame with perf_event_open: cycles,
+// instructions, cache misses and branch misses where the CPU exposes them,
+// and always CPU time, context switches and page faults, which the kernel
+// counts in software (the only kind most VMs offer).
+//
+// The counters belong to the thread that calls Begin() and End() around the
+// stage's work, and are opened on that thread the first time it runs while
+// counting is enabled. While disabled, Begin() and End() cost one relaxed
+// load each.
+class PerfCounters {
+   public:
+    PerfCounters() = default;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    static void SetEnabled(bool enabled);
+    static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    void Begin();
+    void End();
+    // Per frame averages over the last frames, e.g. "Processing IPC"
+    void ReportDiagnostics(const std::string& prefix,
+                           DiagnosticsReport& report);
+
+   private:
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        CPU_TIME,
+        CONTEXT_SWITCHES,
+        PAGE_FAULTS,
+        EVENT_COUNT
+    };
+    using Values = std::array<double, EVENT_COUNT>;
+
+    bool Open();
+    void Close();
+    // Opens events [first, last) as one group, so they are scheduled onto
+    // the PMU together and read with one call
+    bool OpenGroup(Event first, Event last);
+    bool ReadGroup(Event first, Event last, Values& values);
+    bool Read(Values& values);
+
+    static inline std::atomic<bool> enabled_{false};
+    static constexpr std::size_t kWindow = 100;
+    std::array<int, EVENT_COUNT> fds_{-1, -1, -1, -1, -1, -1, -1};
+    bool open_ = false;
+    bool failed_ = false;
+    bool active_ = false;
+    Values begin_{};
+    std::atomic<bool> has_hardware_{false};
+    std::atomic<std::uint64_t> frames_{0};
+    StatisticsQueue<double> cycles_{kWindow};
+    StatisticsQueue<double> instructions_{kWindow};
+    StatisticsQueue<double> ipc_{kWindow};
+    StatisticsQueue<double> cache_misses_{kWindow};
+    StatisticsQueue<double> branch_misses_{kWindow};
+    StatisticsQueue<double> cpu_time_{kWindow};
+    StatisticsQueue<double> context_switches_{kWindow};
+    StatisticsQueue<double> page_faults_{kWindow};
+};
+
+#endif  // PERF_COUNTERS_H
@@ -0,0 +1,269 @@
+/******************************************************************************
+ * Filename:    profiled_mutex.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "diagnostics_report.h"
+
+// What happened to every lock of one name since startup. Locks that share a
+// name, e.g. the frame pools, share a profile.
+struct LockProfile {
+    explicit LockProfile(const std::string& name) : name(name) {}
+
+    const std::string name;
+    std::atomic<std::uint64_t> acquisitions{0};
+    // Acquisitions that found the lock held and had to wait
+    std::atomic<std::uint64_t> contentions{0};
+    std::atomic<std::uint64_t> wait_ns{0};
+    std::atomic<std::uint64_t> max_wait_ns{0};
+    std::atomic<std::uint64_t> hold_ns{0};
+    std::atomic<std::uint64_t> max_hold_ns{0};
+    // Condition variable waits and how they ended
+    std::atomic<std::uint64_t> waits{0};
+    std::atomic<std::uint64_t> timeouts{0};
+    // Woken while the predicate was still false
+    std::atomic<std::uint64_t> spurious_wakeups{0};
+    // Notified while nobody waited: a waiter that doesn't check state
+    // before waiting misses these
+    std::atomic<std::uint64_t> lost_notifies{0};
+};
+
+// Holds the profiles and reports them, e.g. "Lock video_input Contentions".
+// Empty unless built with SPP_LOCK_PROFILING.
+class LockProfiler {
+   public:
+    static LockProfiler& instance();
+    // Profiles live as long as the program, so callers keep the pointer
+    LockProfile* Get(const std::string& name);
+    void ReportDiagnostics(DiagnosticsReport& report);
+
+   private:
+    LockProfiler() = default;
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<LockProfile>> profiles_;
+};
+
+namespace lock_profiling {
+
+inline std::uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline void UpdateMax(std::atomic<std::uint64_t>& max, std::uint64_t value) {
+    auto current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace lock_profiling
+
+// A named std::mutex. Built with SPP_LOCK_PROFILING it records how long
+// lockers wait, how long the lock is held and how often it is contended;
+// otherwise the name is dropped and every call forwards to std::mutex.
+class ProfiledMutex {
+   public:
+#ifdef SPP_LOCK_PROFILING
+    explicit ProfiledMutex(const std::string& name)
+        : profile_(LockProfiler::instance().Get(name)) {}
+#else
+    explicit ProfiledMutex(const std::string&) {}
+#endif
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+#ifdef SPP_LOCK_PROFILING
+    void lock() {
+        if (!mutex_.try_lock()) {
+            auto begin = lock_profiling::NowNs();
+            mutex_.lock();
+            auto wait = lock_profiling::NowNs() - begin;
+            profile_->contentions.fetch_add(1, std::memory_order_relaxed);
+            profile_->wait_ns.fetch_add(wait, std::memory_order_relaxed);
+            lock_profiling::UpdateMax(profile_->max_wait_ns, wait);
+        }
+        BeginHold();
+    }
+    bool try_lock() {
+        if (!mutex_.try_lock()) {
+            return false;
+        }
+        BeginHold();
+        return true;
+    }
+    void unlock() {
+        EndHold();
+        mutex_.unlock();
+    }
+#else
+    void lock() { mutex_.lock(); }
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+#endif
+
+   private:
+    friend class ProfiledConditionVariable;
+
+#ifdef SPP_LOCK_PROFILING
+    // Only the holder touches acquired_ns_
+    void BeginHold() {
+        profile_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        acquired_ns_ = lock_profiling::NowNs();
+    }
+    void EndHold() {
+        auto hold = lock_profiling::NowNs() - acquired_ns_;
+        profile_->hold_ns.fetch_add(hold, std::memory_order_relaxed);
+        lock_profiling::UpdateMax(profile_->max_hold_ns, hold);
+    }
+    LockProfile* profile_;
+    std::uint64_t acquired_ns_ = 0;
+#endif
+    std::mutex mutex_;
+};
+
+// A named std::condition_variable that waits on a ProfiledMutex. Built with
+// SPP_LOCK_PROFILING it counts waits, timeouts, spurious wakeups and
+// notifies that found no waiter, and doesn't count the time spent waiting as
+// time the mutex was held.
+class ProfiledConditionVariable {
+   public:
+    using Lock = std::unique_lock<ProfiledMutex>;
+
+#ifdef SPP_LOCK_PROFILING
+    explicit ProfiledConditionVariable(const std::string& name)
+        : profile_(LockProfiler::instance().Get(name)) {}
+#else
+    explicit ProfiledConditionVariable(const std::string&) {}
+#endif
+    ProfiledConditionVariable(const ProfiledConditionVariable&) = delete;
+    ProfiledConditionVariable& operator=(const ProfiledConditionVariable&) =
+        delete;
+
+    void notify_one() noexcept {
+        CountNotify();
+        cond_.notify_one();
+    }
+    void notify_all() noexcept {
+        CountNotify();
+        cond_.notify_all();
+    }
+
+    void wait(Lock& lock) {
+        Wait(lock, [this](std::unique_lock<std::mutex>& native) {
+            cond_.wait(native);
+            return std::cv_status::no_timeout;
+        });
+    }
+    template <class Predicate>
+    void wait(Lock& lock, Predicate predicate) {
+        if (predicate()) {
+            return;
+        }
+        while (true) {
+            wait(lock);
+            if (predicate()) {
+                return;
+            }
+            CountSpurious();
+        }
+    }
+
+    template <class Clock, class Duration>
+    std::cv_status wait_until(
+        Lock& lock, const std::chrono::time_point<Clock, Duration>& time) {
+        return Wait(lock, [this, &time](std::unique_lock<std::mutex>& native) {
+            return cond_.wait_until(native, time);
+        });
+    }
+    template <class Clock, class Duration, class Predicate>
+    bool wait_until(Lock& lock,
+                    const std::chrono::time_point<Clock, Duration>& time,
+                    Predicate predicate) {
+        if (predicate()) {
+            return true;
+        }
+        while (true) {
+            auto status = wait_until(lock, time);
+            if (predicate()) {
+                return true;
+            }
+            if (status == std::cv_status::timeout) {
+                return false;
+            }
+            CountSpurious();
+        }
+    }
+
+    template <class Rep, class Period>
+    std::cv_status wait_for(Lock& lock,
+                            const std::chrono::duration<Rep, Period>& time) {
+        return wait_until(lock, std::chrono::steady_clock::now() + time);
+    }
+    template <class Rep, class Period, class Predicate>
+    bool wait_for(Lock& lock, const std::chrono::duration<Rep, Period>& time,
+                  Predicate predicate) {
+        return wait_until(lock, std::chrono::steady_clock::now() + time,
+                          std::move(predicate));
+    }
+
+   private:
+    // Waits on the std::mutex inside the lock's mutex; the lock keeps owning
+    // it throughout, as the wait gives it back before returning
+    template <class WaitFunction>
+    std::cv_status Wait(Lock& lock, WaitFunction wait_function) {
+        auto& mutex = *lock.mutex();
+        std::unique_lock<std::mutex> native(mutex.mutex_, std::adopt_lock);
+        struct Release {
+            std::unique_lock<std::mutex>& native;
+            ~Release() { native.release(); }
+        } release{native};
+#ifdef SPP_LOCK_PROFILING
+        profile_->waits.fetch_add(1, std::memory_order_relaxed);
+        waiters_.fetch_add(1, std::memory_order_relaxed);
+        mutex.EndHold();
+        auto status = wait_function(native);
+        mutex.BeginHold();
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        if (status == std::cv_status::timeout) {
+            profile_->timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+        return status;
+#else
+        return wait_function(native);
+#endif
+    }
+
+#ifdef SPP_LOCK_PROFILING
+    void CountNotify() {
+        if (waiters_.load(std::memory_order_relaxed) == 0) {
+            profile_->lost_notifies.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void CountSpurious() {
+        profile_->spurious_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+    LockProfile* profile_;
+    std::atomic<int> waiters_{0};
+#else
+    void CountNotify() {}
+    void CountSpurious() {}
+#endif
+    std::condition_variable cond_;
+};
+
+#endif  // PROFILED_MUTEX_H
@@ -6,12 +6,12 @@
 #ifndef STATISTICS_QUEUE_H
 #define STATISTICS_QUEUE_H
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <deque>
-#include <iostream>
-#include <mutex>
-#include <queue>  // Added missing include
-#include <stdexcept>
+#include <cstdint>
+#include <functional>
+#include <vector>
 
 template <typename T>
 struct Statistics {
@@ -22,62 +22,194 @@ struct Statistics {
     double standard_deviation;
 };
 
+// Statistics over the last max_size values pushed.
+//
+// Push() is for one writer at a time (e.g. the stage that times itself) and
+// never blocks: the window minimum and maximum come from monotonic queues,
+// and the moments are updated with Welford's method, so a push is amortized
+// O(1). The moments are recomputed from the window every time it wraps, which
+// keeps rounding drift bounded over long runs.
+//
+// GetStatistics() may be called from any thread. It reads a snapshot the
+// writer publishes under a sequence lock, so a reader never stalls the
+// writer; it retries in the rare case the writer was mid-update.
 template <typename T>
 class StatisticsQueue {
    public:
     explicit StatisticsQueue(std::size_t max_size)
-        : max_size_(max_size), sum_(0), sum_squared_(0), size_(0) {}
+        : max_size_(std::max<std::size_t>(max_size, 1)),
+          values_(max_size_),
+          min_queue_(max_size_),
+          max_queue_(max_size_),
+          pushed_(0),
+          slot_(0),
+          count_(0),
+          mean_(0.0),
+          m2_(0.0),
+          sequence_(0),
+          snapshot_count_(0),
+          snapshot_minimum_(T()),
+          snapshot_maximum_(T()),
+          snapshot_average_(0.0),
+          snapshot_variance_(0.0) {}
+
+    StatisticsQueue(const StatisticsQueue&) = delete;
+    StatisticsQueue& operator=(const StatisticsQueue&) = delete;
 
     void Push(const T& value) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.size() >= max_size_) {
-            auto oldest_value = queue_.back();
-            queue_.pop_back();
-            max_heap_.pop();
-            min_heap_.pop();
-            sum_ -= oldest_value;
-            sum_squared_ -=
-                (oldest_value * oldest_value);  // Added missing semicolon
+        auto index = pushed_++;
+        auto x = static_cast<double>(value);
+        if (count_ == max_size_) {
+            // Replace the oldest value; n stays the same
+            auto y = static_cast<double>(values_[slot_]);
+            auto mean = mean_ + (x - y) / static_cast<double>(count_);
+            m2_ += (x - y) * (x - mean + y - mean_);
+            mean_ = mean;
+        } else {
+            count_++;
+            auto delta = x - mean_;
+            mean_ += delta / static_cast<double>(count_);
+            m2_ += delta * (x - mean_);
+        }
+        values_[slot_] = value;
+        if (++slot_ == max_size_) {
+            slot_ = 0;
+            Recompute();
         }
-        queue_.push_front(value);
-        max_heap_.push(value);
-        min_heap_.push(value);
-        size_ = queue_.size();
-        sum_ += value;
-        sum_squared_ += (value * value);
-    }
 
-    Statistics<T> GetStatistics() {
-        Statistics<T> statistics{0, 0, 0, 0, 0};
+        // Evicting first keeps each queue within max_size_ entries
+        auto oldest = index >= max_size_ ? index - max_size_ + 1 : 0;
+        min_queue_.Evict(oldest);
+        max_queue_.Evict(oldest);
+        min_queue_.Push(index, value, std::less_equal<T>());
+        max_queue_.Push(index, value, std::greater_equal<T>());
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) {
-            return statistics;  // Return an empty statistics object
-        }
+        Publish();
+    }
 
-        auto inv_size = 1.0 / static_cast<double>(size_);
-        auto average = static_cast<double>(sum_) * inv_size;
-        auto average_squared = (average * average);
-        auto variance = (static_cast<double>(sum_squared_) * inv_size) -
-                        average_squared;  // Added underscore to sum_squared_
-
-        statistics.minimum = min_heap_.top();
-        statistics.maximum = max_heap_.top();
-        statistics.average = average;
-        statistics.variance = variance;
-        statistics.standard_deviation = std::sqrt(variance);
+    Statistics<T> GetStatistics() const {
+        Statistics<T> statistics{T(), T(), 0, 0, 0};
+        while (true) {
+            auto sequence = sequence_.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                continue;
+            }
+            auto count = snapshot_count_.load(std::memory_order_relaxed);
+            statistics.minimum =
+                snapshot_minimum_.load(std::memory_order_relaxed);
+            statistics.maximum =
+                snapshot_maximum_.load(std::memory_order_relaxed);
+            statistics.average =
+                snapshot_average_.load(std::memory_order_relaxed);
+            statistics.variance =
+                snapshot_variance_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            if (count == 0) {
+                return Statistics<T>{T(), T(), 0, 0, 0};
+            }
+            break;
+        }
+        statistics.standard_deviation = std::sqrt(statistics.variance);
         return statistics;
     }
 
    private:
-    std::deque<T> queue_;
-    std::priority_queue<T> max_heap_;
-    std::priority_queue<T, std::vector<T>, std::greater<T>> min_heap_;
-    T sum_;
-    T sum_squared_;  // Added underscore to sum_squared_
-    std::size_t size_;
+    // The values that can still become the window's extreme, in push order,
+    // held in a fixed ring so a push never allocates
+    class MonotonicQueue {
+       public:
+        explicit MonotonicQueue(std::size_t capacity)
+            : entries_(capacity), head_(0), tail_(0), size_(0) {}
+
+        template <typename Compare>
+        void Push(std::uint64_t index, const T& value, Compare keep_before) {
+            // A value that is no better than the new one can never be the
+            // extreme again, since it also leaves the window first
+            while (size_ > 0 && !keep_before(Back().value, value)) {
+                tail_ = tail_ == 0 ? entries_.size() - 1 : tail_ - 1;
+                size_--;
+            }
+            entries_[tail_] = Entry{index, value};
+            if (++tail_ == entries_.size()) {
+                tail_ = 0;
+            }
+            size_++;
+        }
+
+        void Evict(std::uint64_t oldest) {
+            while (size_ > 0 && entries_[head_].index < oldest) {
+                if (++head_ == entries_.size()) {
+                    head_ = 0;
+                }
+                size_--;
+            }
+        }
+
+        const T& Front() const { return entries_[head_].value; }
+
+       private:
+        struct Entry {
+            std::uint64_t index;
+            T value;
+        };
+        const Entry& Back() const {
+            return entries_[tail_ == 0 ? entries_.size() - 1 : tail_ - 1];
+        }
+        std::vector<Entry> entries_;
+        std::size_t head_;
+        std::size_t tail_;
+        std::size_t size_;
+    };
+
+    void Recompute() {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < count_; i++) {
+            sum += static_cast<double>(values_[i]);
+        }
+        mean_ = sum / static_cast<double>(count_);
+        double m2 = 0.0;
+        for (std::size_t i = 0; i < count_; i++) {
+            auto delta = static_cast<double>(values_[i]) - mean_;
+            m2 += delta * delta;
+        }
+        m2_ = m2;
+    }
+
+    void Publish() {
+        auto sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        snapshot_count_.store(count_, std::memory_order_relaxed);
+        snapshot_minimum_.store(min_queue_.Front(), std::memory_order_relaxed);
+        snapshot_maximum_.store(max_queue_.Front(), std::memory_order_relaxed);
+        snapshot_average_.store(mean_, std::memory_order_relaxed);
+        snapshot_variance_.store(
+            std::max(0.0, m2_ / static_cast<double>(count_)),
+            std::memory_order_relaxed);
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Writer state
     std::size_t max_size_;
-    mutable std::mutex mutex_;
+    std::vector<T> values_;
+    MonotonicQueue min_queue_;
+    MonotonicQueue max_queue_;
+    std::uint64_t pushed_;
+    std::size_t slot_;
+    std::size_t count_;
+    double mean_;
+    double m2_;
+
+    // Snapshot published for readers
+    std::atomic<std::uint64_t> sequence_;
+    std::atomic<std::size_t> snapshot_count_;
+    std::atomic<T> snapshot_minimum_;
+    std::atomic<T> snapshot_maximum_;
+    std::atomic<double> snapshot_average_;
+    std::atomic<double> snapshot_variance_;
 };
 
 #endif  // STATISTICS_QUEUE_H
@@ -4,7 +4,7 @@
  *****************************************************************************/
 
 #ifndef TIMING_H
-#define TTIMING_H
+#define TIMING_H
 
 #include <chrono>
 
@@ -20,4 +20,4 @@ double TimeFunction(Func&& func) {
     return duration.count();  // Return the execution time in seconds
 }
 
-#endif  // TASK_H
\ No newline at end of file
+#endif  // TIMING_H
\ No newline at end of file
@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Filename:    trace.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Ticks of the time stamp counter where there is one, nanoseconds otherwise.
+// Traces convert ticks to time once, when they are written.
+inline std::uint64_t TraceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+struct TraceEvent {
+    const char* name;
+    std::uint64_t begin;
+    std::uint64_t end;
+    std::uint64_t frame;
+};
+
+// The spans of one thread. Only that thread writes, and the oldest spans are
+// overwritten once the ring is full; a reader copies out what it can and drops
+// whatever the writer may have overwritten meanwhile. The capacity must be a
+// power of two.
+class TraceRing {
+   public:
+    TraceRing(std::size_t capacity, const std::string& thread_name);
+    void Record(const TraceEvent& event);
+    std::vector<TraceEvent> Read() const;
+    const std::string& ThreadName() const { return thread_name_; }
+    int ThreadId() const { return thread_id_; }
+    // Set when the thread exits, so the ring can be dropped
+    std::atomic<bool> exited_{false};
+
+   private:
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<std::uint64_t> begin{0};
+        std::atomic<std::uint64_t> end{0};
+        std::atomic<std::uint64_t> frame{0};
+    };
+    std::vector<Slot> slots_;
+    std::uint64_t mask_;
+    std::atomic<std::uint64_t> head_{0};
+    std::string thread_name_;
+    int thread_id_;
+};
+
+// Records spans of the pipeline stages into per thread rings and writes them
+// as a Chrome trace (chrome://tracing or ui.perfetto.dev), with the spans of
+// each frame linked across threads. While tracing is off a span costs one
+// relaxed load, and a thread gets its ring only once it records while on.
+class Tracer {
+   public:
+    static constexpr std::size_t kRingCapacity = 1 << 14;
+
+    static Tracer& instance();
+    static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    void Start();
+    void Stop();
+    // Names the calling thread in traces, e.g. after the task it runs
+    void SetThreadName(const std::string& name);
+    void Record(const char* name, std::uint64_t begin, std::uint64_t end,
+                std::uint64_t frame);
+    // Everything recorded since the last Start() that is still in the rings;
+    // returns the number of spans written
+    std::size_t WriteChromeTrace(const std::string& filename);
+
+   private:
+    Tracer() = default;
+    TraceRing& Ring();
+    static inline std::atomic<bool> enabled_{false};
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<TraceRing>> rings_;
+    std::uint64_t start_timestamp_ = 0;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+// Records the enclosing scope as a span named name, which must be a string
+// literal. frame links the spans that worked on the same frame, 0 if none.
+class TraceSpan {
+   public:
+    explicit TraceSpan(const char* name, std::uint64_t frame = 0)
+        : name_(name),
+          frame_(frame),
+          begin_(Tracer::Enabled() ? TraceTimestamp() : 0) {}
+    ~TraceSpan() {
+        if (begin_ != 0) {
+            Tracer::instance().Record(name_, begin_, TraceTimestamp(), frame_);
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    // For spans that only learn their frame at the end, e.g. waits
+    void SetFrame(std::uint64_t frame) { frame_ = frame; }
+
+   private:
+    const char* name_;
+    std::uint64_t frame_;
+    std::uint64_t begin_;
+};
+
+#endif  // TRACE_H
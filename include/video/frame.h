@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Filename:    frame.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "diagnostics_report.h"
+#include "frame_views.h"
+#include "opencv2/core.hpp"
+#include "profiled_mutex.h"
+
+class FramePool;
+
+// A handle to a frame that is shared between stages by reference count.
+// Read() never copies. Write() returns a buffer only this handle can see: the
+// frame's own buffer when nothing else references it, otherwise a copy in a
+// buffer taken from the pool (copy-on-write). A published frame is therefore
+// never modified under a reader, and the producer never refills a buffer
+// that is still being read.
+//
+// The handle also records the pixel format of the buffer, so a YUV 4:2:0
+// frame can travel between stages without being converted to BGR.
+class Frame {
+   public:
+    Frame() = default;
+    bool empty() const { return !mat_ || mat_->empty(); }
+    const cv::Mat& Read() const;
+    cv::Mat& Write();
+    PixelFormat Format() const { return format_; }
+    void SetFormat(PixelFormat format) { format_ = format; }
+    // Numbered at capture so traces can follow a frame across stages; 0 if
+    // not numbered
+    std::uint64_t Id() const { return id_; }
+    void SetId(std::uint64_t id) { id_ = id; }
+    // Also set at capture, so the last stage can tell how late a frame is
+    std::chrono::steady_clock::time_point CaptureTime() const {
+        return capture_time_;
+    }
+    void SetCaptureTime(std::chrono::steady_clock::time_point time) {
+        capture_time_ = time;
+    }
+
+   private:
+    friend class FramePool;
+    Frame(std::shared_ptr<cv::Mat> mat, std::shared_ptr<FramePool> pool)
+        : mat_(std::move(mat)), pool_(std::move(pool)) {}
+    bool IsShared() const;
+    std::shared_ptr<cv::Mat> mat_;
+    std::shared_ptr<FramePool> pool_;
+    PixelFormat format_ = PixelFormat::BGR;
+    std::uint64_t id_ = 0;
+    std::chrono::steady_clock::time_point capture_time_;
+};
+
+// Recycles frame buffers, so steady state capture and copy-on-write don't
+// allocate. A buffer comes back when the last Frame referencing it is gone;
+// one whose pixels are still referenced by a plain cv::Mat is dropped instead.
+class FramePool : public std::enable_shared_from_this<FramePool> {
+   public:
+    explicit FramePool(std::size_t max_free = 4);
+    // A frame with a writable, unshared buffer of any size
+    Frame Acquire();
+    // Takes over a buffer that was allocated elsewhere, e.g. a conversion
+    // result, so it is recycled once released
+    Frame Adopt(const cv::Mat& mat, PixelFormat format = PixelFormat::BGR);
+    void ReportDiagnostics(const std::string& prefix,
+                           DiagnosticsReport& report);
+
+   private:
+    friend class Frame;
+    Frame Wrap(cv::Mat&& mat);
+    void Recycle(cv::Mat&& mat);
+    ProfiledMutex mutex_{"frame_pool"};
+    std::vector<cv::Mat> free_;
+    std::size_t max_free_;
+    std::atomic<std::uint64_t> frames_allocated_;
+    std::atomic<std::uint64_t> frames_recycled_;
+    std::atomic<std::uint64_t> copies_;
+    std::atomic<std::uint64_t> writes_in_place_;
+};
+
+#endif  // FRAME_H
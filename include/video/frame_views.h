@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Filename:    frame_views.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef FRAME_VIEWS_H
+#define FRAME_VIEWS_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+enum class PixelFormat {
+    ANY,
+    BGR,
+    GRAY,
+    HSV,
+    // Planar YUV 4:2:0 in OpenCV's layout: a single channel Mat with the Y
+    // plane in the first two thirds of the rows and the chroma planes below
+    I420,
+    NV12,
+    COUNT,
+};
+
+const char* PixelFormatName(PixelFormat format);
+bool IsYuv420(PixelFormat format);
+// The largest size with the same aspect ratio that fits within max_size and
+// is no larger than size. A zero width or height leaves that dimension
+// unconstrained.
+cv::Size FitSize(cv::Size size, cv::Size max_size);
+
+// Derived views of the frame that is currently moving through a stage, e.g.
+// its grayscale plane. A view is converted at most once per frame and shared by
+// every transformer or consumer that asks for it; view buffers are reused from
+// frame to frame.
+//
+// Analysis-only transformers, such as detectors, don't draw into the frame;
+// they add overlays instead, which are drawn once the next transformer needs
+// the exact pixels. That keeps the cached views valid for every detector that
+// runs on the same frame.
+//
+// For a YUV 4:2:0 frame the gray view is the Y plane itself, so luma-only
+// consumers such as detectors never convert or copy; BGR is derived only when
+// someone asks for it.
+//
+// Views can also be requested at a reduced size. Each level of this
+// resolution ladder is resized once per frame, from the smallest level
+// already built that is large enough, so a 480p detector and a 640p preview
+// share the work.
+class FrameViews {
+   public:
+    using Overlay = std::pair<cv::Rect, cv::Scalar>;
+
+    void Reset(const cv::Mat& frame, PixelFormat format);
+    // Like Reset() but keeps pending overlays, for a stage that only changed
+    // the frame's format and not its geometry
+    void Rebase(const cv::Mat& frame, PixelFormat format);
+    // Drops the reference to the frame but keeps the view buffers
+    void Clear();
+    PixelFormat Format() const { return format_; }
+    const cv::Mat& View(PixelFormat format);
+    // The view scaled down to fit within max_size; an empty size is the full
+    // resolution view
+    const cv::Mat& View(PixelFormat format, cv::Size max_size);
+    cv::Mat Take(PixelFormat format);
+    void AddOverlay(const cv::Rect& rect, const cv::Scalar& color);
+    bool HasOverlays() const { return !overlays_.empty(); }
+    const std::vector<Overlay>& Overlays() const { return overlays_; }
+    // Hands the overlays to the views of an enclosing frame, e.g. from a
+    // region of interest whose top left corner is at offset
+    void MoveOverlays(FrameViews& target, cv::Point offset);
+    void DrawOverlays(cv::Mat& frame);
+    std::uint64_t Conversions() const { return conversions_; }
+    std::uint64_t Resizes() const { return resizes_; }
+
+   private:
+    struct Level {
+        PixelFormat format;
+        cv::Mat mat;
+        bool valid;
+    };
+
+    static constexpr std::size_t kFormatCount =
+        static_cast<std::size_t>(PixelFormat::COUNT);
+    void Convert(PixelFormat format);
+    cv::Mat frame_;
+    PixelFormat format_ = PixelFormat::BGR;
+    std::array<cv::Mat, kFormatCount> views_;
+    std::array<bool, kFormatCount> valid_{};
+    // A deque keeps references to built levels valid as more are added
+    std::deque<Level> levels_;
+    std::vector<Overlay> overlays_;
+    std::uint64_t conversions_ = 0;
+    std::uint64_t resizes_ = 0;
+};
+
+#endif  // FRAME_VIEWS_H
@@ -6,6 +6,8 @@
 #ifndef VIDEO_INPUT_H
 #define VIDEO_INPUT_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 
 #include "opencv2/core.hpp"
@@ -24,12 +26,21 @@ class VideoInput : public VideoTask {
     void Stop();
     void Shutdown();
     void ChangeSource(std::shared_ptr<VideoSourceFactory> new_source_factory);
+    // BGR or I420; an I420 frame is half the size and its Y plane is the
+    // gray image detectors need. I420 needs even dimensions, so an odd last
+    // row or column is cropped off.
+    bool SetFrameFormat(PixelFormat format);
 
    private:
-    void GetInputFrame(cv::Mat& frame);
+    void GetInputFrame(Frame& frame);
     static void TaskFcn(Task* task);
     std::shared_ptr<VideoSourceFactory> source_factory_;
     std::shared_ptr<VideoSource> source_;
+    std::atomic<PixelFormat> frame_format_;
+    cv::Mat capture_;
+    // The odd capture size last warned about
+    cv::Size cropped_size_;
+    std::uint64_t next_frame_id_;
     bool running_;
 };
 
@@ -24,7 +24,7 @@ class VideoSource {
     virtual void Close() = 0;
 };
 
-class Webcam : public VideoSource {
+class Webcam final : public VideoSource {
    public:
     void Open() override;
     void Close() override;
@@ -35,7 +35,7 @@ class Webcam : public VideoSource {
 };
 
 using VideoSourceFilename = std::string;
-class VideoFile : public VideoSource {
+class VideoFile final : public VideoSource {
    public:
     explicit VideoFile(const VideoSourceFilename filename)
         : filename_(filename) {}
@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Filename:    mjpeg_server.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef MJPEG_SERVER_H
+#define MJPEG_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "statistics.h"
+#include "task.h"
+#include "video_consumer.h"
+
+using MjpegBuffer = std::shared_ptr<const std::vector<uchar>>;
+
+struct MjpegServerConfig {
+    std::string bind_address = "127.0.0.1";
+    std::uint16_t port = 8080;
+    int jpeg_quality = 80;
+};
+
+// Serves the video as an MJPEG stream over HTTP so pipelines on headless
+// machines can be previewed from a browser. Each frame is JPEG encoded at most
+// once, on the encoder task, and only while someone is watching. Every client
+// has its own sender thread that always picks up the newest encoded buffer, so
+// a slow viewer skips frames instead of slowing down the pipeline or the other
+// viewers.
+class MjpegServer final : public VideoConsumer {
+   public:
+    explicit MjpegServer(const MjpegServerConfig& config);
+    ~MjpegServer() override;
+    void Consume(const cv::Mat& frame) override;
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+    StatisticsQueue<double> encode_time_stats_{100};
+
+   private:
+    struct Client {
+        int socket;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+    static void EncoderTaskFcn(Task* task);
+    static void ServerTaskFcn(Task* task);
+    void OpenListenSocket();
+    void AcceptClient();
+    void ReapClients(bool all);
+    void ServeClient(Client* client);
+    bool SendAll(int socket, const void* data, std::size_t size);
+    // False once stopping or once the client hangs up, which is checked
+    // while no frames arrive, e.g. when the pipeline is paused
+    bool WaitForFrame(int socket, std::uint64_t last_sequence,
+                      MjpegBuffer& buffer, std::uint64_t& sequence);
+    MjpegServerConfig config_;
+    Task encoder_task_;
+    Task server_task_;
+    int listen_socket_;
+    std::mutex mutex_;
+    std::condition_variable frame_cond_;
+    std::condition_variable jpeg_cond_;
+    bool stopping_;
+    cv::Mat pending_frame_;
+    cv::Mat encode_frame_;
+    bool frame_pending_;
+    MjpegBuffer latest_jpeg_;
+    std::uint64_t latest_sequence_;
+    std::list<std::unique_ptr<Client>> clients_;
+    std::atomic<std::size_t> client_count_;
+    std::atomic<std::uint64_t> frames_encoded_;
+    std::atomic<std::uint64_t> frames_skipped_;
+};
+
+class MjpegServerFactory : public VideoConsumerFactory {
+   public:
+    explicit MjpegServerFactory(const MjpegServerConfig& config)
+        : config_(config) {}
+    std::shared_ptr<VideoConsumer> Create() override {
+        return std::make_shared<MjpegServer>(config_);
+    }
+
+   private:
+    MjpegServerConfig config_;
+};
+
+#endif  // MJPEG_SERVER_H
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Filename:    rate_limited_consumer.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef RATE_LIMITED_CONSUMER_H
+#define RATE_LIMITED_CONSUMER_H
+
+#include <memory>
+#include <string>
+
+#include "rate_limiter.h"
+#include "video_consumer.h"
+
+// Passes a subset of frames to an inner consumer, e.g. a preview at 15 fps
+// next to a recorder at the full rate. Skipped frames are never converted or
+// scaled for the consumer; the consumer keeps its last frame.
+class RateLimitedConsumer final : public VideoConsumer {
+   public:
+    // The name suffixes the diagnostics, e.g. "Rate Limited Output player"
+    RateLimitedConsumer(const RateLimit& limit,
+                        std::shared_ptr<VideoConsumer> inner,
+                        const std::string& name)
+        : limiter_(limit), inner_(inner), name_(name) {}
+    void Consume(const cv::Mat& frame) override { inner_->Consume(frame); }
+    PixelFormat InputFormat() const override { return inner_->InputFormat(); }
+    cv::Size InputSize() const override { return inner_->InputSize(); }
+    bool WantsFrame() override {
+        return limiter_.Admit() && inner_->WantsFrame();
+    }
+    void ReportDiagnostics(DiagnosticsReport& report) override {
+        limiter_.ReportDiagnostics("Rate Limited Output " + name_, report);
+        inner_->ReportDiagnostics(report);
+    }
+
+   private:
+    RateLimiter limiter_;
+    std::shared_ptr<VideoConsumer> inner_;
+    std::string name_;
+};
+
+class RateLimitedConsumerFactory : public VideoConsumerFactory {
+   public:
+    RateLimitedConsumerFactory(const RateLimit& limit,
+                               std::shared_ptr<VideoConsumerFactory> inner,
+                               const std::string& name)
+        : limit_(limit), inner_(inner), name_(name) {}
+    std::shared_ptr<VideoConsumer> Create() override {
+        auto inner = inner_->Create();
+        if (!inner) {
+            return nullptr;
+        }
+        return std::make_shared<RateLimitedConsumer>(limit_, inner, name_);
+    }
+
+   private:
+    RateLimit limit_;
+    std::shared_ptr<VideoConsumerFactory> inner_;
+    std::string name_;
+};
+
+#endif  // RATE_LIMITED_CONSUMER_H
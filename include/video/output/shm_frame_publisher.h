@@ -0,0 +1,73 @@
+/******************************************************************************
+ * Filename:    shm_frame_publisher.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef SHM_FRAME_PUBLISHER_H
+#define SHM_FRAME_PUBLISHER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "opencv2/core.hpp"
+#include "shm_frame_ring.h"
+#include "statistics.h"
+#include "video_consumer.h"
+
+// Readers only want the newest frames; every slot is a full frame of memory
+constexpr std::uint32_t kShmFramePublisherMinSlots = 2;
+constexpr std::uint32_t kShmFramePublisherMaxSlots = 64;
+
+// Publishes frames into a POSIX shared-memory ring so that other processes on
+// the host can read them in place (see ShmFrameReader). The frame is copied
+// once into the ring; readers never copy it again. When slot_capacity is zero
+// the ring is sized for the first frame that is published. A later frame that
+// doesn't fit replaces the ring with one sized for it, under a new generation
+// that readers map when they reopen.
+class ShmFramePublisher final : public VideoConsumer {
+   public:
+    ShmFramePublisher(const std::string& name, std::uint32_t slot_count,
+                      std::size_t slot_capacity);
+    ~ShmFramePublisher() override;
+    void Consume(const cv::Mat& frame) override;
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+    StatisticsQueue<double> publish_time_stats_{100};
+
+   private:
+    void CreateRing(std::size_t slot_capacity);
+    void DestroyRing();
+    void WriteSlot(const cv::Mat& frame);
+    std::string name_;
+    std::uint32_t slot_count_;
+    std::size_t slot_capacity_;
+    ShmFrameRingHeader* ring_;
+    std::size_t ring_size_;
+    bool ring_failed_;
+    std::uint32_t generation_;
+    std::uint64_t sequence_;
+    std::atomic<std::uint64_t> frames_published_;
+    std::atomic<std::uint64_t> frames_dropped_;
+    std::atomic<std::uint64_t> ring_recreations_;
+};
+
+class ShmFramePublisherFactory : public VideoConsumerFactory {
+   public:
+    explicit ShmFramePublisherFactory(
+        const std::string& name = kShmFrameRingDefaultName,
+        std::uint32_t slot_count = 4, std::size_t slot_capacity = 0)
+        : name_(name), slot_count_(slot_count), slot_capacity_(slot_capacity) {}
+    std::shared_ptr<VideoConsumer> Create() override {
+        return std::make_shared<ShmFramePublisher>(name_, slot_count_,
+                                                   slot_capacity_);
+    }
+
+   private:
+    std::string name_;
+    std::uint32_t slot_count_;
+    std::size_t slot_capacity_;
+};
+
+#endif  // SHM_FRAME_PUBLISHER_H
@@ -8,11 +8,24 @@
 
 #include <memory>
 
+#include "diagnostics_report.h"
+#include "frame_views.h"
 #include "opencv2/core.hpp"
 
 class VideoConsumer {
    public:
+    virtual ~VideoConsumer() = default;
     virtual void Consume(const cv::Mat& frame) = 0;
+    // ANY accepts BGR, gray or HSV images; a YUV 4:2:0 frame is converted to
+    // BGR for such a consumer
+    virtual PixelFormat InputFormat() const { return PixelFormat::ANY; }
+    // The largest frame the consumer has use for; larger frames are scaled
+    // down once per size and shared. Empty means full resolution.
+    virtual cv::Size InputSize() const { return cv::Size(); }
+    // Asked once per frame before the frame is prepared for Consume(), so a
+    // consumer that runs at a lower rate doesn't cost a conversion either
+    virtual bool WantsFrame() { return true; }
+    virtual void ReportDiagnostics(DiagnosticsReport& report) {}
 };
 
 class VideoConsumerFactory {
@@ -7,8 +7,14 @@
 #define VIDEO_OUTPUT_H
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "diagnostics_report.h"
+#include "frame_views.h"
 #include "opencv2/core.hpp"
+#include "profiled_mutex.h"
+#include "statistics.h"
 #include "task.h"
 #include "video_consumer.h"
 #include "video_task.h"
@@ -25,14 +31,27 @@ class VideoOutput : public VideoTask {
     void Stop();
     void ChangeConsumer(
         std::shared_ptr<VideoConsumerFactory> new_consumer_factory);
+    std::shared_ptr<VideoConsumer> AddConsumer(
+        std::shared_ptr<VideoConsumerFactory> consumer_factory);
+    // Waits for a frame being output to the consumer, so the output task
+    // never holds the last reference and runs its teardown, e.g. a recorder
+    // draining its queue
+    void RemoveConsumer(const std::shared_ptr<VideoConsumer>& consumer);
+    void ReportDiagnostics(DiagnosticsReport& report);
+    StatisticsQueue<double> time_stats_{100};
 
    private:
     static void TaskFcn(Task* task);
-    void GetInputFrame(cv::Mat& frame);
-    void OutputFrame(cv::Mat& frame);
+    void GetInputFrame(Frame& frame);
+    void OutputFrame(const Frame& frame);
+    void WaitForOutputFrame();
     VideoTask& input_;
     std::shared_ptr<VideoConsumerFactory> consumer_factory_;
-    std::shared_ptr<VideoConsumer> consumer_;
+    std::vector<std::shared_ptr<VideoConsumer>> consumers_;
+    ProfiledMutex consumers_mutex_{"consumers"};
+    // Held while a frame is output
+    ProfiledMutex output_mutex_{"output_frame"};
+    FrameViews views_;
     bool running_;
 };
 
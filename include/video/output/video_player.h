@@ -3,16 +3,77 @@
  * Copyright (c) 2023 Keaton Scheible
  *****************************************************************************/
 
+#ifndef VIDEO_PLAYER_H
+#define VIDEO_PLAYER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "opencv2/highgui.hpp"
+#include "profiled_mutex.h"
+#include "task.h"
 #include "video_consumer.h"
 
-class VideoPlayer : public VideoConsumer {
+class VideoPlayer;
+
+// Owns the one thread that talks to highgui. The GTK and Qt backends can't be
+// driven from several threads, so every player's window is created, drawn,
+// serviced and destroyed here. The thread runs while any player exists.
+class VideoPlayerDisplay {
    public:
-    VideoPlayer(const std::string& windowName);
+    static VideoPlayerDisplay& instance();
+    void Add(VideoPlayer* player);
+    // Once this returns the display no longer touches the player; its window
+    // is destroyed on the display thread
+    void Remove(VideoPlayer* player);
+
+   private:
+    VideoPlayerDisplay();
+    static void TaskFcn(Task* task);
+    Task task_;
+    // Serializes Add and Remove, which start and join the task
+    ProfiledMutex lifecycle_mutex_{"player_display_lifecycle"};
+    ProfiledMutex mutex_{"player_display"};
+    ProfiledConditionVariable cond_{"player_display"};
+    bool stopping_;
+    std::vector<VideoPlayer*> players_;
+    std::vector<std::string> closing_windows_;
+};
+
+// Displays the video in a window. Rendering happens on the display thread at
+// the display rate: Consume() only replaces the frame waiting to be shown, so
+// GUI event handling and scaling never throttle the output task. Frames that
+// are replaced before they are shown are counted as dropped.
+class VideoPlayer final : public VideoConsumer {
+   public:
+    VideoPlayer(const std::string& windowName,
+                TaskUpdatePeriodMs display_period = TaskUpdatePeriodMs(16),
+                cv::Size max_display_size = cv::Size(1280, 720));
+    ~VideoPlayer() override;
     void Consume(const cv::Mat& frame) override;
+    cv::Size InputSize() const override { return max_display_size_; }
+    void ReportDiagnostics(DiagnosticsReport& report) override;
 
    private:
+    friend class VideoPlayerDisplay;
+    // Called on the display thread only
+    bool TakePendingFrame();
+    void Present();
     std::string windowName_;
+    TaskUpdatePeriodMs display_period_;
+    cv::Size max_display_size_;
+    ProfiledMutex mutex_{"video_player"};
+    cv::Mat pending_frame_;
+    cv::Mat render_frame_;
+    cv::Mat display_frame_;
+    bool frame_pending_;
+    bool window_open_;
+    std::chrono::steady_clock::time_point last_present_time_;
+    std::atomic<std::uint64_t> frames_presented_;
+    std::atomic<std::uint64_t> frames_dropped_;
 };
 
 class VideoPlayerFactory : public VideoConsumerFactory {
@@ -26,3 +87,5 @@ class VideoPlayerFactory : public VideoConsumerFactory {
    private:
     std::string windowName_;
 };
+
+#endif  // VIDEO_PLAYER_H
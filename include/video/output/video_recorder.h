@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Filename:    video_recorder.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef VIDEO_RECORDER_H
+#define VIDEO_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "opencv2/videoio.hpp"
+#include "statistics.h"
+#include "task.h"
+#include "video_consumer.h"
+
+enum class RecorderDropPolicy {
+    DROP_OLDEST,
+    DROP_NEWEST,
+};
+
+using RecorderSegmentMinutes = std::chrono::minutes;
+
+struct VideoRecorderConfig {
+    std::string filename;
+    double fps = 30.0;
+    std::size_t queue_capacity = 30;
+    RecorderDropPolicy drop_policy = RecorderDropPolicy::DROP_OLDEST;
+    // A duration of zero disables segment rotation
+    RecorderSegmentMinutes segment_duration{0};
+};
+
+// Encodes frames to disk on a dedicated thread. Consume() only copies the frame
+// into a bounded queue, so a slow encoder or a segment rotation never blocks
+// the output task; when the queue is full, frames are dropped according to the
+// configured drop policy.
+class VideoRecorder final : public VideoConsumer {
+   public:
+    explicit VideoRecorder(const VideoRecorderConfig& config);
+    ~VideoRecorder() override;
+    void Consume(const cv::Mat& frame) override;
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+    StatisticsQueue<double> encode_time_stats_{100};
+
+   private:
+    static void TaskFcn(Task* task);
+    void EncodeFrame(const cv::Mat& frame);
+    bool SegmentExpired() const;
+    void OpenSegment(const cv::Mat& frame);
+    void CloseSegment();
+    std::string SegmentFilename() const;
+    int FourCC() const;
+    void RecycleBuffer(cv::Mat& buffer);
+    VideoRecorderConfig config_;
+    Task task_;
+    std::deque<cv::Mat> queue_;
+    std::vector<cv::Mat> free_buffers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_;
+    cv::VideoWriter writer_;
+    cv::Size segment_size_;
+    int segment_type_;
+    std::chrono::steady_clock::time_point segment_start_;
+    std::atomic<std::uint64_t> frames_encoded_;
+    std::atomic<std::uint64_t> frames_dropped_;
+    std::atomic<std::uint64_t> segments_written_;
+};
+
+class VideoRecorderFactory : public VideoConsumerFactory {
+   public:
+    explicit VideoRecorderFactory(const VideoRecorderConfig& config)
+        : config_(config) {}
+    std::shared_ptr<VideoConsumer> Create() override {
+        return std::make_shared<VideoRecorder>(config_);
+    }
+
+   private:
+    VideoRecorderConfig config_;
+};
+
+#endif  // VIDEO_RECORDER_H
@@ -16,19 +16,49 @@ enum class Colorspace {
     BGR2HSV,
 };
 
-class BypassTransformer : public VideoTransformer {
+class BypassTransformer final : public VideoTransformer {
    public:
     void Transform(cv::Mat& frame) override;
+    bool IsFormatConversion() const override { return true; }
+    bool ModifiesFrame() const override { return false; }
 };
 
-class BGR2GRAYTransformer : public VideoTransformer {
+class BGR2GRAYTransformer final : public VideoTransformer {
    public:
     void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    PixelFormat InputFormat() const override { return PixelFormat::BGR; }
+    PixelFormat OutputFormat(PixelFormat input) const override {
+        return PixelFormat::GRAY;
+    }
+    bool IsFormatConversion() const override { return true; }
 };
 
-class BGR2HSVTransformer : public VideoTransformer {
+class BGR2HSVTransformer final : public VideoTransformer {
    public:
     void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    PixelFormat InputFormat() const override { return PixelFormat::BGR; }
+    PixelFormat OutputFormat(PixelFormat input) const override {
+        return PixelFormat::HSV;
+    }
+    bool IsFormatConversion() const override { return true; }
+};
+
+// Converts to a format required by the next transformer. Inserted by format
+// negotiation, never created from a command.
+class FormatConverter final : public VideoTransformer {
+   public:
+    explicit FormatConverter(PixelFormat format) : format_(format) {}
+    void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    PixelFormat OutputFormat(PixelFormat input) const override {
+        return format_;
+    }
+    bool IsFormatConversion() const override { return true; }
+
+   private:
+    PixelFormat format_;
 };
 
 class ColorspaceTransformerFactory : public VideoTransformerFactory {
@@ -7,8 +7,10 @@
 #define HAAR_CASCADE_CLASSIFIER_H
 
 #include <map>
+#include <string>
 
 #include "opencv2/imgproc.hpp"
+#include "opencv2/objdetect.hpp"
 #include "video_transformer.h"
 
 #define HAAR_CASCADE_CLASSIFIER_PATH "assets/data/haarcascades/"
@@ -33,28 +35,44 @@ enum class HaarCascadeClassifierType {
     LicensePlateRus16Stages,
 };
 
-class HaarCascadeClassifier : public VideoTransformer {
+class HaarCascadeClassifier final : public VideoTransformer {
    public:
-    HaarCascadeClassifier(const std::string haar_cascades_filename)
-        : haar_cascades_filename_(haar_cascades_filename){};
+    // Detection runs on the gray view scaled to fit within detect_size, an
+    // empty size detects at full resolution
+    HaarCascadeClassifier(const std::string haar_cascades_filename,
+                          cv::Size detect_size = cv::Size())
+        : haar_cascades_filename_(haar_cascades_filename),
+          detect_size_(detect_size){};
     void Transform(cv::Mat& frame) override;
+    // Detects on the shared grayscale view and marks the detections as
+    // overlays, so several classifiers on one frame convert it only once
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    bool ModifiesFrame() const override { return false; }
 
    private:
     std::string haar_cascades_filename_;
+    cv::CascadeClassifier cascade_;
+    bool cascade_loaded_ = false;
+    cv::Size detect_size_;
+    FrameViews views_;
 };
 
 class HaarCascadeClassifierFactory : public VideoTransformerFactory {
    public:
     HaarCascadeClassifierFactory(
-        HaarCascadeClassifierType haar_cascade_classifier_type)
-        : haar_cascade_classifier_type_(haar_cascade_classifier_type) {}
+        HaarCascadeClassifierType haar_cascade_classifier_type,
+        cv::Size detect_size = cv::Size())
+        : haar_cascade_classifier_type_(haar_cascade_classifier_type),
+          detect_size_(detect_size) {}
     std::shared_ptr<VideoTransformer> Create() override {
         return std::make_shared<HaarCascadeClassifier>(
-            haar_cascade_classifier_file_map_[haar_cascade_classifier_type_]);
+            haar_cascade_classifier_file_map_[haar_cascade_classifier_type_],
+            detect_size_);
     }
 
    private:
     HaarCascadeClassifierType haar_cascade_classifier_type_;
+    cv::Size detect_size_;
     std::map<HaarCascadeClassifierType, std::string>
         haar_cascade_classifier_file_map_ = {
             {HaarCascadeClassifierType::Eyes,
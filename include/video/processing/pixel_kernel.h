@@ -0,0 +1,203 @@
+/******************************************************************************
+ * Filename:    pixel_kernel.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef PIXEL_KERNEL_H
+#define PIXEL_KERNEL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "opencv2/core.hpp"
+
+// Per-pixel operations that can be fused into one pass over a frame. A pixel
+// is held as floats in registers between operations; an operation maps a
+// PixelValue<N> to a PixelValue<M>.
+template <std::size_t N>
+using PixelValue = std::array<float, N>;
+
+struct BgrToGrayOp {
+    PixelValue<1> operator()(const PixelValue<3>& pixel) const {
+        return {0.114f * pixel[0] + 0.587f * pixel[1] + 0.299f * pixel[2]};
+    }
+};
+
+struct GainOp {
+    float gain = 1.0f;
+    float bias = 0.0f;
+    template <std::size_t N>
+    PixelValue<N> operator()(const PixelValue<N>& pixel) const {
+        PixelValue<N> out;
+        for (std::size_t c = 0; c < N; c++) {
+            out[c] = pixel[c] * gain + bias;
+        }
+        return out;
+    }
+};
+
+struct ThresholdOp {
+    float threshold = 127.0f;
+    float max_value = 255.0f;
+    template <std::size_t N>
+    PixelValue<N> operator()(const PixelValue<N>& pixel) const {
+        PixelValue<N> out;
+        for (std::size_t c = 0; c < N; c++) {
+            out[c] = pixel[c] > threshold ? max_value : 0.0f;
+        }
+        return out;
+    }
+};
+
+// The table must hold 256 entries and outlive the kernel
+struct LutOp {
+    const uchar* table = nullptr;
+    template <std::size_t N>
+    PixelValue<N> operator()(const PixelValue<N>& pixel) const {
+        PixelValue<N> out;
+        for (std::size_t c = 0; c < N; c++) {
+            auto index = static_cast<int>(std::clamp(pixel[c], 0.0f, 255.0f));
+            out[c] = table[index];
+        }
+        return out;
+    }
+};
+
+template <std::size_t Channel>
+struct ExtractChannelOp {
+    template <std::size_t N, typename = std::enable_if_t<(Channel < N)>>
+    PixelValue<1> operator()(const PixelValue<N>& pixel) const {
+        return {pixel[Channel]};
+    }
+};
+
+// Fuses a compile-time list of operations into a single loop. Running
+// FusedKernel<BgrToGrayOp, GainOp, ThresholdOp> reads every source pixel once
+// and writes every result once, where the equivalent sequence of cv:: calls
+// sweeps the frame through memory once per operation. Rows are walked in
+// tiles of kPixelKernelTilePixels; the loop over a tile carries no
+// dependencies and no calls, so the compiler can vectorize it.
+constexpr int kPixelKernelTilePixels = 4096;
+
+template <typename... Ops>
+class FusedKernel {
+   public:
+    FusedKernel() = default;
+    explicit FusedKernel(Ops... ops) : ops_(std::move(ops)...) {}
+
+    template <std::size_t N>
+    auto Apply(const PixelValue<N>& pixel) const {
+        return ApplyFrom<0>(pixel);
+    }
+
+    // The source must be 8-bit with a channel count the first operation
+    // accepts; dst is (re)allocated as 8-bit with as many channels as the last
+    // operation produces. Returns false if the source doesn't fit the kernel.
+    bool Run(const cv::Mat& src, cv::Mat& dst) const {
+        if (src.depth() != CV_8U) {
+            return false;
+        }
+        switch (src.channels()) {
+            case 1:
+                return RunChannels<1>(src, dst);
+            case 3:
+                return RunChannels<3>(src, dst);
+            case 4:
+                return RunChannels<4>(src, dst);
+            default:
+                return false;
+        }
+    }
+
+    template <std::size_t N>
+    static constexpr bool Accepts() {
+        return AcceptsFrom<0, PixelValue<N>>();
+    }
+
+   private:
+    template <std::size_t I, typename Pixel>
+    static constexpr bool AcceptsFrom() {
+        if constexpr (I == sizeof...(Ops)) {
+            return true;
+        } else {
+            using Op = std::tuple_element_t<I, std::tuple<Ops...>>;
+            if constexpr (std::is_invocable_v<const Op&, const Pixel&>) {
+                return AcceptsFrom<I + 1, std::invoke_result_t<const Op&,
+                                                               const Pixel&>>();
+            } else {
+                return false;
+            }
+        }
+    }
+
+    template <std::size_t I, std::size_t N>
+    auto ApplyFrom(const PixelValue<N>& pixel) const {
+        if constexpr (I == sizeof...(Ops)) {
+            return pixel;
+        } else {
+            return ApplyFrom<I + 1>(std::get<I>(ops_)(pixel));
+        }
+    }
+
+    template <std::size_t N>
+    bool RunChannels(const cv::Mat& src, cv::Mat& dst) const {
+        if constexpr (!Accepts<N>()) {
+            return false;
+        } else {
+            RunAccepted<N>(src, dst);
+            return true;
+        }
+    }
+
+    template <std::size_t N>
+    void RunAccepted(const cv::Mat& src, cv::Mat& dst) const {
+        using Output = decltype(std::declval<FusedKernel>().Apply(
+            std::declval<PixelValue<N>>()));
+        constexpr std::size_t M = std::tuple_size<Output>::value;
+
+        // In-place use would overwrite pixels still to be read when the
+        // channel count shrinks
+        cv::Mat source = src.data == dst.data ? src.clone() : src;
+        dst.create(source.rows, source.cols, CV_8UC(static_cast<int>(M)));
+
+        int rows = source.rows;
+        int cols = source.cols;
+        if (source.isContinuous() && dst.isContinuous()) {
+            cols *= rows;
+            rows = 1;
+        }
+        for (int row = 0; row < rows; row++) {
+            const uchar* in = source.ptr<uchar>(row);
+            uchar* out = dst.ptr<uchar>(row);
+            for (int tile = 0; tile < cols; tile += kPixelKernelTilePixels) {
+                int end = std::min(cols, tile + kPixelKernelTilePixels);
+                RunTile<N, M>(in, out, tile, end);
+            }
+        }
+    }
+
+    template <std::size_t N, std::size_t M>
+    void RunTile(const uchar* in, uchar* out, int begin, int end) const {
+        for (int i = begin; i < end; i++) {
+            PixelValue<N> pixel;
+            for (std::size_t c = 0; c < N; c++) {
+                pixel[c] = in[i * N + c];
+            }
+            auto result = Apply(pixel);
+            for (std::size_t c = 0; c < M; c++) {
+                // Round and saturate without cvRound, which blocks
+                // vectorization
+                out[i * M + c] = static_cast<uchar>(
+                    std::clamp(result[c] + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+
+    std::tuple<Ops...> ops_;
+};
+
+#endif  // PIXEL_KERNEL_H
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Filename:    rate_limited_transformer.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef RATE_LIMITED_TRANSFORMER_H
+#define RATE_LIMITED_TRANSFORMER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rate_limiter.h"
+#include "video_transformer.h"
+
+// Runs an analysis transformer on a subset of frames, e.g. body detection on
+// every 5th frame, and replays its last overlays on the frames in between.
+// Transformers that change pixels can't be rate limited: neither their stale
+// output nor the raw frame is a coherent stand-in. Format conversions are
+// cheap and always run. A change in frame size always runs the inner
+// transformer.
+class RateLimitedTransformer final : public VideoTransformer {
+   public:
+    // The name prefixes the diagnostics, e.g. "Rate Limited haar face". The
+    // inner transformer must not modify the frame.
+    RateLimitedTransformer(const RateLimit& limit,
+                           std::shared_ptr<VideoTransformer> inner,
+                           const std::string& name);
+    void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    PixelFormat InputFormat() const override { return inner_->InputFormat(); }
+    PixelFormat OutputFormat(PixelFormat input) const override {
+        return inner_->OutputFormat(input);
+    }
+    bool IsFormatConversion() const override {
+        return inner_->IsFormatConversion();
+    }
+    bool ModifiesFrame() const override { return inner_->ModifiesFrame(); }
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+
+   private:
+    void CarryForward(cv::Mat& frame, FrameViews& views);
+    RateLimiter limiter_;
+    std::shared_ptr<VideoTransformer> inner_;
+    std::string name_;
+    cv::Size last_input_size_;
+    std::vector<FrameViews::Overlay> last_overlays_;
+    FrameViews views_;
+};
+
+class RateLimitedTransformerFactory : public VideoTransformerFactory {
+   public:
+    RateLimitedTransformerFactory(
+        const RateLimit& limit, std::shared_ptr<VideoTransformerFactory> inner,
+        const std::string& name)
+        : limit_(limit), inner_(inner), name_(name) {}
+    std::shared_ptr<VideoTransformer> Create() override;
+
+   private:
+    RateLimit limit_;
+    std::shared_ptr<VideoTransformerFactory> inner_;
+    std::string name_;
+};
+
+#endif  // RATE_LIMITED_TRANSFORMER_H
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * Filename:    roi_transformer.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef ROI_TRANSFORMER_H
+#define ROI_TRANSFORMER_H
+
+#include <memory>
+#include <vector>
+
+#include "video_transformer.h"
+
+// Runs an inner transformer on regions of interest only, e.g. a doorway or a
+// lane, so per-frame work scales with the region area rather than the sensor
+// resolution. Each region is a cv::Mat header into the frame, not a copy.
+//
+// Overlays the inner transformer adds are moved to the frame's views with the
+// region offset applied. A result that replaces a region, e.g. a threshold
+// mask, is written back in the frame's format, so the frame keeps its format
+// and geometry.
+class RoiTransformer final : public VideoTransformer {
+   public:
+    RoiTransformer(std::vector<cv::Rect> regions,
+                   std::shared_ptr<VideoTransformer> inner);
+    void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    bool ModifiesFrame() const override { return inner_->ModifiesFrame(); }
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+
+   private:
+    const cv::Mat& RegionSource(FrameViews& views, PixelFormat& format);
+    std::vector<cv::Rect> regions_;
+    std::shared_ptr<VideoTransformer> inner_;
+    std::vector<FrameViews> region_views_;
+    FrameViews result_views_;
+    FrameViews views_;
+};
+
+class RoiTransformerFactory : public VideoTransformerFactory {
+   public:
+    RoiTransformerFactory(std::vector<cv::Rect> regions,
+                          std::shared_ptr<VideoTransformerFactory> inner)
+        : regions_(std::move(regions)), inner_(inner) {}
+    std::shared_ptr<VideoTransformer> Create() override;
+
+   private:
+    std::vector<cv::Rect> regions_;
+    std::shared_ptr<VideoTransformerFactory> inner_;
+};
+
+#endif  // ROI_TRANSFORMER_H
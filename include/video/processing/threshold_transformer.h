@@ -0,0 +1,48 @@
+/******************************************************************************
+ * Filename:    threshold_transformer.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef THRESHOLD_TRANSFORMER_H
+#define THRESHOLD_TRANSFORMER_H
+
+#include <memory>
+
+#include "pixel_kernel.h"
+#include "video_transformer.h"
+
+// Produces a binary mask of the pixels brighter than a level after a gain is
+// applied. Gray conversion, gain and threshold run as one fused pass; frames
+// the fused kernels don't take, e.g. 16-bit ones, go through OpenCV instead.
+class ThresholdTransformer final : public VideoTransformer {
+   public:
+    ThresholdTransformer(float level, float gain);
+    void Transform(cv::Mat& frame) override;
+    PixelFormat OutputFormat(PixelFormat input) const override {
+        return PixelFormat::GRAY;
+    }
+
+   private:
+    // False if the frame's channel count can't be made gray
+    bool ThresholdUnfused(const cv::Mat& frame, cv::Mat& mask) const;
+    float level_;
+    float gain_;
+    bool unfused_logged_;
+    FusedKernel<BgrToGrayOp, GainOp, ThresholdOp> color_kernel_;
+    FusedKernel<GainOp, ThresholdOp> gray_kernel_;
+};
+
+class ThresholdTransformerFactory : public VideoTransformerFactory {
+   public:
+    ThresholdTransformerFactory(float level, float gain = 1.0f)
+        : level_(level), gain_(gain) {}
+    std::shared_ptr<VideoTransformer> Create() override {
+        return std::make_shared<ThresholdTransformer>(level_, gain_);
+    }
+
+   private:
+    float level_;
+    float gain_;
+};
+
+#endif  // THRESHOLD_TRANSFORMER_H
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Filename:    transformer_chain.h
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#ifndef TRANSFORMER_CHAIN_H
+#define TRANSFORMER_CHAIN_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "statistics.h"
+#include "video_transformer.h"
+
+// Runs an ordered list of transformers on the same frame in a single stage, so
+// a chain costs no extra task, handoff or frame buffer per link. Each link is
+// timed on its own so diagnostics show which one is hot.
+//
+// Pixel formats are negotiated as links are appended: a conversion to the
+// format the frame is already in is dropped, and a conversion is inserted
+// only where a link needs a specific format. At run time the links share
+// one set of FrameViews, so no frame is converted to the same format twice.
+// A chain of conversions and detectors only reads its input frame, so it can
+// start from the Y plane of a YUV frame without a BGR conversion.
+class TransformerChain : public VideoTransformer {
+   public:
+    struct Link {
+        std::string name;
+        std::shared_ptr<VideoTransformer> transformer;
+        PixelFormat output_format;
+        std::unique_ptr<StatisticsQueue<double>> time_stats;
+    };
+
+    explicit TransformerChain(PixelFormat input_format = PixelFormat::BGR)
+        : input_format_(input_format), output_format_(input_format) {}
+    void Append(const std::string& name,
+                std::shared_ptr<VideoTransformer> transformer);
+    void Transform(cv::Mat& frame) override;
+    void Transform(cv::Mat& frame, FrameViews& views) override;
+    PixelFormat InputFormat() const override { return input_format_; }
+    PixelFormat OutputFormat(PixelFormat input) const override;
+    bool ModifiesFrame() const override;
+    void ReportDiagnostics(DiagnosticsReport& report) override;
+
+   private:
+    void AppendLink(const std::string& name,
+                    std::shared_ptr<VideoTransformer> transformer);
+    std::vector<Link> links_;
+    PixelFormat input_format_;
+    PixelFormat output_format_;
+    FrameViews views_;
+};
+
+using TransformerChainLink =
+    std::pair<std::string, std::shared_ptr<VideoTransformerFactory>>;
+
+class TransformerChainFactory : public VideoTransformerFactory {
+   public:
+    explicit TransformerChainFactory(std::vector<TransformerChainLink> links)
+        : links_(std::move(links)) {}
+    std::shared_ptr<VideoTransformer> Create() override;
+
+   private:
+    std::vector<TransformerChainLink> links_;
+};
+
+#endif  // TRANSFORMER_CHAIN_H
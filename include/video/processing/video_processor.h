@@ -7,8 +7,13 @@
 #define VIDEO_PROCESSOR_H
 
 #include <memory>
+#include <mutex>
 
+#include "diagnostics_report.h"
+#include "frame.h"
+#include "frame_views.h"
 #include "opencv2/core.hpp"
+#include "profiled_mutex.h"
 #include "statistics.h"
 #include "task.h"
 #include "video_task.h"
@@ -25,15 +30,18 @@ class VideoProcessor : public VideoTask {
     void Stop();
     void ChangeTransformer(
         std::shared_ptr<VideoTransformerFactory> new_transformer_factory);
+    void ReportDiagnostics(DiagnosticsReport& report);
     StatisticsQueue<double> time_stats_{100};
 
    private:
     static void TaskFcn(Task* task);
-    void GetInputFrame(cv::Mat& frame);
-    void ProcessFrame(cv::Mat& frame);
+    void GetInputFrame(Frame& frame);
+    void ProcessFrame(Frame& frame);
     VideoTask& input_;
     std::shared_ptr<VideoTransformerFactory> transformer_factory_;
     std::shared_ptr<VideoTransformer> transformer_;
+    ProfiledMutex transformer_mutex_{"transformer"};
+    FrameViews views_;
     bool running_;
 };
 
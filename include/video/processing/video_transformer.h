@@ -8,11 +8,31 @@
 
 #include <memory>
 
+#include "diagnostics_report.h"
+#include "frame_views.h"
 #include "opencv2/core.hpp"
 
 class VideoTransformer {
    public:
+    virtual ~VideoTransformer() = default;
     virtual void Transform(cv::Mat& frame) = 0;
+    // Transforms a frame whose derived views are shared with the other
+    // transformers of the stage
+    virtual void Transform(cv::Mat& frame, FrameViews& views) {
+        Transform(frame);
+    }
+    // The format a transformer needs its input in; ANY means it adapts to
+    // any image format. Transformers that modify the frame are never handed
+    // a YUV 4:2:0 buffer, the stage converts it to BGR first.
+    virtual PixelFormat InputFormat() const { return PixelFormat::ANY; }
+    virtual PixelFormat OutputFormat(PixelFormat input) const { return input; }
+    // A pure format conversion can be elided when the frame is already in the
+    // target format
+    virtual bool IsFormatConversion() const { return false; }
+    // A transformer that only reads the frame (and adds overlays) leaves the
+    // cached views valid
+    virtual bool ModifiesFrame() const { return true; }
+    virtual void ReportDiagnostics(DiagnosticsReport& report) {}
 };
 
 class VideoTransformerFactory {
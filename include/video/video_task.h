@@ -8,9 +8,16 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <string>
 
+#include "diagnostics_report.h"
+#include "frame.h"
+#include "metrics.h"
 #include "opencv2/core.hpp"
+#include "perf_counters.h"
+#include "profiled_mutex.h"
 #include "task.h"
 
 class VideoTask {
@@ -19,20 +26,30 @@ class VideoTask {
               TaskFunction function, std::atomic<bool>& shutting_down);
     virtual ~VideoTask();
     void Init();
-    void GetOutputFrame(cv::Mat& frame);
+    // Shares the latest published frame; the caller must hold mutex_
+    void GetOutputFrame(Frame& frame);
     void Shutdown();
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    void ReportFrameDiagnostics(const std::string& prefix,
+                                DiagnosticsReport& report);
+    void ReportPerfDiagnostics(const std::string& prefix,
+                               DiagnosticsReport& report);
+    // Named after the task, e.g. "video_input"
+    ProfiledMutex mutex_;
+    ProfiledConditionVariable cond_;
 
    protected:
-    void SwapBuffers();
+    void Publish(Frame frame);
     void NotifyListeners();
     void Throttle();
     Task task_;
     std::atomic<bool>& shutting_down_;
-    cv::Mat buffer1_, buffer2_;
-    cv::Mat& current_buffer_;
-    cv::Mat& next_buffer_;
+    std::shared_ptr<FramePool> frame_pool_;
+    Frame current_frame_;
+    // Registered as <task name>_frames_total and <task name>_time_seconds
+    std::shared_ptr<Counter> frames_total_;
+    std::shared_ptr<Histogram> time_histogram_;
+    // Counted around the stage's work on each frame
+    PerfCounters perf_counters_;
 };
 
 #endif  // VIDEO_TASK_H
\ No newline at end of file
@@ -5,22 +5,74 @@
 
 #include "app.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
-#include <fstream>
 #include <iostream>
 #include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
 #include "colorspace_transformer.h"
+#include "error_handling.h"
+#include "flight_recorder.h"
+#include "graph_pipeline.h"
 #include "haar_cascade_classifier.h"
 #include "logger.h"
+#include "metrics.h"
+#include "metrics_exporter.h"
+#include "mjpeg_server.h"
+#include "perf_counters.h"
+#include "pipeline_graph.h"
+#include "pipeline_manager.h"
+#include "rate_limited_consumer.h"
+#include "rate_limited_transformer.h"
+#include "roi_transformer.h"
+#include "shm_frame_publisher.h"
 #include "task.h"
+#include "threshold_transformer.h"
+#include "trace.h"
+#include "transformer_chain.h"
 #include "video_consumer.h"
 #include "video_player.h"
+#include "video_recorder.h"
 #include "video_source.h"
 #include "video_transformer.h"
 
+namespace {
+
+// stoul alone would wrap negative numbers and truncate large ones
+bool ParsePort(const std::string& text, std::uint16_t& port) {
+    try {
+        std::size_t end;
+        auto value = std::stoul(text, &end);
+        if (end != text.size() || value < 1 || value > 65535 ||
+            text.front() == '-') {
+            return false;
+        }
+        port = static_cast<std::uint16_t>(value);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool ParsePositiveInt(const std::string& text, int& value) {
+    try {
+        std::size_t end;
+        value = std::stoi(text, &end);
+        return end == text.size() && value > 0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+}  // namespace
+
 App::App(TaskId id, TaskPriority priority, TaskUpdatePeriodMs period_ms,
          std::atomic<bool>& shutting_down, std::condition_variable& shutdown_cv)
     : task_(id, priority, period_ms, TaskFcn),
@@ -38,9 +90,12 @@ App::App(TaskId id, TaskPriority priority, TaskUpdatePeriodMs period_ms,
                     std::make_shared<VideoPlayerFactory>("Video Player"),
                     TaskId::VIDEO_OUTPUT, TaskPriority::VIDEO_OUTPUT,
                     TaskUpdatePeriodMs(33), shutting_down),
+      pipeline_manager_(TaskId::PIPELINE_MANAGER,
+                        TaskPriority::PIPELINE_MANAGER, TaskUpdatePeriodMs(100),
+                        std::thread::hardware_concurrency(), shutting_down),
       diagnostics_(TaskId::DIAGNOSTICS, TaskPriority::DIAGNOSTICS,
                    TaskUpdatePeriodMs(1000), video_input_, video_processor_,
-                   video_output_, shutting_down) {
+                   video_output_, pipeline_manager_, shutting_down) {
     task_.SetData(this);
 }
 
@@ -51,11 +106,16 @@ void App::Init() {
     video_input_.Init();
     video_processor_.Init();
     video_output_.Init();
+    pipeline_manager_.Init();
     diagnostics_.Init();
+    FlightRecorder::instance().Start(FlightRecorderConfig());
 }
 
 void App::Shutdown() {
+    FlightRecorder::instance().Stop();
+    metrics_exporter_.reset();
     diagnostics_.Shutdown();
+    pipeline_manager_.Shutdown();
     video_output_.Shutdown();
     video_processor_.Shutdown();
     video_input_.Shutdown();
@@ -83,6 +143,9 @@ void App::GetTokenizedInput(std::vector<std::string>& tokens) {
     while (std::getline(iss, token, ' ')) {
         tokens.push_back(token);
     }
+    if (!input.empty()) {
+        FlightRecorder::instance().Record("app", "command", 0, 0.0, input);
+    }
 }
 
 void App::ParseTokens(std::vector<std::string>& tokens) {
@@ -104,11 +167,29 @@ void App::ParseTokens(std::vector<std::string>& tokens) {
     } else if (token == "stop") {
         Stop();
     } else if (token == "stats") {
-        PrintStats();
+        if (!tokens.empty() && tokens.front() == "file") {
+            tokens.erase(tokens.begin());
+            bool enabled = tokens.empty() || tokens.front() != "off";
+            diagnostics_.SetFileOutput(enabled);
+        } else {
+            PrintStats();
+        }
+    } else if (token == "metrics") {
+        ParseMetricsTokens(tokens);
+    } else if (token == "trace") {
+        ParseTraceTokens(tokens);
+    } else if (token == "flight") {
+        ParseFlightTokens(tokens);
+    } else if (token == "perf") {
+        ParsePerfTokens(tokens);
     } else if (token == "i" || token == "input") {
         ParseInputTokens(tokens);
     } else if (token == "p" || token == "processing") {
         ParseProcessingTokens(tokens);
+    } else if (token == "o" || token == "output") {
+        ParseOutputTokens(tokens);
+    } else if (token == "pl" || token == "pipeline") {
+        ParsePipelineTokens(tokens);
     } else {
         spdlog::warn(
             "Invalid command. Type 'help' to see a list of valid commands");
@@ -121,22 +202,147 @@ void App::ParseInputTokens(std::vector<std::string>& tokens) {
         return;
     }
 
+    if (tokens.front() == "format") {
+        tokens.erase(tokens.begin());
+        if (tokens.empty()) {
+            spdlog::error("You must provide a frame format");
+        } else if (tokens.front() == "bgr") {
+            video_input_.SetFrameFormat(PixelFormat::BGR);
+        } else if (tokens.front() == "i420") {
+            video_input_.SetFrameFormat(PixelFormat::I420);
+        } else {
+            spdlog::error("Invalid frame format: {}", tokens.front());
+        }
+        return;
+    }
+
+    auto source_factory = ParseSourceTokens(tokens);
+    if (source_factory) {
+        video_input_.ChangeSource(source_factory);
+    }
+}
+
+void App::ParseMetricsTokens(std::vector<std::string>& tokens) {
+    if (!tokens.empty() && tokens.front() == "stop") {
+        if (metrics_exporter_) {
+            metrics_exporter_.reset();
+            spdlog::info("Stopped the metrics exporter");
+        }
+        return;
+    }
+
+    MetricsExporterConfig config;
+    if (!tokens.empty() && tokens.front() == "unix") {
+        tokens.erase(tokens.begin());
+        if (tokens.empty()) {
+            spdlog::error("You must provide a socket path");
+            return;
+        }
+        config.unix_path = tokens.front();
+    } else if (!tokens.empty() && !ParsePort(tokens.front(), config.port)) {
+        spdlog::error("Invalid port: {}, expected 1 to 65535", tokens.front());
+        return;
+    }
+
+    // Replace a running exporter first so it can give up its address
+    metrics_exporter_.reset();
+    try {
+        metrics_exporter_ = std::make_unique<MetricsExporter>(config);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to start the metrics exporter: {}", e.what());
+    }
+}
+
+void App::ParseTraceTokens(std::vector<std::string>& tokens) {
+    if (tokens.empty() || (tokens.front() != "start" &&
+                           tokens.front() != "stop")) {
+        spdlog::error("Usage: trace start | trace stop [file.json]");
+        return;
+    }
+
+    auto& tracer = Tracer::instance();
+    if (tokens.front() == "start") {
+        tracer.Start();
+        spdlog::info("Tracing started");
+        return;
+    }
+
+    tokens.erase(tokens.begin());
+    auto filename = tokens.empty() ? std::string("trace.json") : tokens.front();
+    tracer.Stop();
+    try {
+        auto spans = tracer.WriteChromeTrace(filename);
+        spdlog::info("Wrote {} spans to {} (open in ui.perfetto.dev)", spans,
+                     filename);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to write the trace: {}", e.what());
+    }
+}
+
+void App::ParseFlightTokens(std::vector<std::string>& tokens) {
+    auto& recorder = FlightRecorder::instance();
+    if (!tokens.empty() && tokens.front() == "dump") {
+        recorder.RequestDump("requested");
+        return;
+    }
+
+    auto config = recorder.Config();
+    for (auto* time : {&config.frame_deadline, &config.margin}) {
+        if (tokens.empty()) {
+            break;
+        }
+        int ms;
+        if (!ParsePositiveInt(tokens.front(), ms)) {
+            spdlog::error("Invalid time: {}, expected a number of ms",
+                          tokens.front());
+            return;
+        }
+        *time = std::chrono::milliseconds(ms);
+        tokens.erase(tokens.begin());
+    }
+    recorder.Start(config);
+    spdlog::info(
+        "Flight recorder dumps to {}/ when a frame is more than {} ms past "
+        "its {} ms deadline",
+        config.folder, config.margin.count(), config.frame_deadline.count());
+}
+
+void App::ParsePerfTokens(std::vector<std::string>& tokens) {
+    if (tokens.empty() || (tokens.front() != "on" && tokens.front() != "off")) {
+        spdlog::error("Usage: perf on|off");
+        return;
+    }
+    bool enabled = tokens.front() == "on";
+    PerfCounters::SetEnabled(enabled);
+    spdlog::info("Perf counters {}; see 'stats'", enabled ? "on" : "off");
+}
+
+std::shared_ptr<VideoSourceFactory> App::ParseSourceTokens(
+    std::vector<std::string>& tokens) {
+    if (tokens.empty()) {
+        spdlog::error("You must provide a video source");
+        return nullptr;
+    }
+
     auto token = tokens.front();
     tokens.erase(tokens.begin());
 
     if (token == "webcam") {
-        SetSourceWebcam();
+        return std::make_shared<VideoSourceFactory>(VideoSourceType::WEBCAM);
     } else if (token == "file") {
         if (tokens.empty()) {
             spdlog::error("You must provide a filename");
+            return nullptr;
         }
         auto filename = tokens.front();
-        SetSourceVideoFile(filename);
-
+        tokens.erase(tokens.begin());
+        return std::make_shared<VideoSourceFactory>(VideoSourceType::FILE,
+                                                    filename);
     } else {
         spdlog::error(
             "Invalid command. Type 'input' to see a list of the valid input "
             "commands");
+        return nullptr;
     }
 }
 
@@ -146,81 +352,579 @@ void App::ParseProcessingTokens(std::vector<std::string>& tokens) {
         return;
     }
 
+    auto transformer_factory = ParseTransformerTokens(tokens);
+    if (transformer_factory) {
+        video_processor_.ChangeTransformer(transformer_factory);
+    }
+}
+
+std::shared_ptr<VideoTransformerFactory> App::ParseTransformerTokens(
+    std::vector<std::string>& tokens) {
+    if (tokens.empty()) {
+        spdlog::error("You must provide a processing type");
+        return nullptr;
+    }
+
     auto token = tokens.front();
     tokens.erase(tokens.begin());
 
     if (token == "bypass") {
-        SetTransformerColorspace(Colorspace::BYPASS);
+        return std::make_shared<ColorspaceTransformerFactory>(
+            Colorspace::BYPASS);
     } else if (token == "gray") {
-        SetTransformerColorspace(Colorspace::BGR2GRAY);
+        return std::make_shared<ColorspaceTransformerFactory>(
+            Colorspace::BGR2GRAY);
     } else if (token == "hsv") {
-        SetTransformerColorspace(Colorspace::BGR2HSV);
+        return std::make_shared<ColorspaceTransformerFactory>(
+            Colorspace::BGR2HSV);
+    } else if (token == "threshold") {
+        try {
+            auto level = 127.0f;
+            auto gain = 1.0f;
+            if (!tokens.empty()) {
+                level = std::stof(tokens.front());
+                tokens.erase(tokens.begin());
+            }
+            if (!tokens.empty()) {
+                gain = std::stof(tokens.front());
+                tokens.erase(tokens.begin());
+            }
+            return std::make_shared<ThresholdTransformerFactory>(level, gain);
+        } catch (const std::exception&) {
+            spdlog::error("Invalid threshold: {}", tokens.front());
+            return nullptr;
+        }
+    } else if (token == "chain") {
+        return ParseTransformerChainTokens(tokens);
+    } else if (token == "roi") {
+        return ParseRoiTokens(tokens);
+    } else if (token == "rate") {
+        RateLimit limit;
+        if (!ParseRateTokens(tokens, limit)) {
+            return nullptr;
+        }
+        // Named after the inner command, e.g. "haar face"
+        std::string name;
+        for (auto& inner_token : tokens) {
+            name += (name.empty() ? "" : " ") + inner_token;
+        }
+        auto inner_factory = ParseTransformerTokens(tokens);
+        if (!inner_factory) {
+            return nullptr;
+        }
+        // Skipped frames would flicker between processed and raw pixels
+        auto inner = inner_factory->Create();
+        if (inner && inner->ModifiesFrame()) {
+            spdlog::error(
+                "Only analysis, e.g. 'haar', can be rate limited; {} changes "
+                "the frame",
+                name);
+            return nullptr;
+        }
+        return std::make_shared<RateLimitedTransformerFactory>(
+            limit, inner_factory, name);
     } else if (token == "haar") {
         if (tokens.empty()) {
             Help("processing haar");
-            return;
+            return nullptr;
         }
         auto haar_processing_type = tokens.front();
+        tokens.erase(tokens.begin());
 
+        HaarCascadeClassifierType type;
         if (haar_processing_type == "eyes") {
-            SetTrasformerHaarCascadeClassifier(HaarCascadeClassifierType::Eyes);
+            type = HaarCascadeClassifierType::Eyes;
         } else if (haar_processing_type == "left_eye") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::LeftEye);
+            type = HaarCascadeClassifierType::LeftEye;
         } else if (haar_processing_type == "right_eye") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::RightEye);
+            type = HaarCascadeClassifierType::RightEye;
         } else if (haar_processing_type == "eyes_w_glasses") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::EyesWithGlasses);
+            type = HaarCascadeClassifierType::EyesWithGlasses;
         } else if (haar_processing_type == "face") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::FrontalFace);
+            type = HaarCascadeClassifierType::FrontalFace;
         } else if (haar_processing_type == "face_alt") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::FrontalFaceAlt);
+            type = HaarCascadeClassifierType::FrontalFaceAlt;
         } else if (haar_processing_type == "face_alt2") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::FrontalFaceAlt2);
+            type = HaarCascadeClassifierType::FrontalFaceAlt2;
         } else if (haar_processing_type == "face_alt_tree") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::FrontalFaceAltTree);
+            type = HaarCascadeClassifierType::FrontalFaceAltTree;
         } else if (haar_processing_type == "face_profile") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::ProfileFace);
+            type = HaarCascadeClassifierType::ProfileFace;
         } else if (haar_processing_type == "smile") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::Smile);
+            type = HaarCascadeClassifierType::Smile;
         } else if (haar_processing_type == "body") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::FullBody);
+            type = HaarCascadeClassifierType::FullBody;
         } else if (haar_processing_type == "upper_body") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::UpperBody);
+            type = HaarCascadeClassifierType::UpperBody;
         } else if (haar_processing_type == "lower_body") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::LowerBody);
+            type = HaarCascadeClassifierType::LowerBody;
         } else if (haar_processing_type == "cat_face") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::CatFrontalFace);
+            type = HaarCascadeClassifierType::CatFrontalFace;
         } else if (haar_processing_type == "cat_face_ext") {
-            SetTrasformerHaarCascadeClassifier(
-                HaarCascadeClassifierType::CatFrontalFaceExtended);
+            type = HaarCascadeClassifierType::CatFrontalFaceExtended;
         } else {
             spdlog::error(
                 "Invalid haar processing command type. Type 'processing haar' "
                 "to see a list of the valid haar processing commands");
+            return nullptr;
         }
 
+        // An optional height, e.g. 480, to detect on a scaled down frame
+        cv::Size detect_size;
+        if (!tokens.empty()) {
+            int height;
+            if (!ParsePositiveInt(tokens.front(), height)) {
+                spdlog::error("Invalid detection height: {}", tokens.front());
+                return nullptr;
+            }
+            detect_size = cv::Size(0, height);
+            tokens.erase(tokens.begin());
+        }
+        return std::make_shared<HaarCascadeClassifierFactory>(type,
+                                                              detect_size);
     } else {
         spdlog::error(
             "Invalid command. Type 'processing' to see a list of the valid "
             "processing commands");
+        return nullptr;
+    }
+}
+
+std::shared_ptr<VideoTransformerFactory> App::ParseRoiTokens(
+    std::vector<std::string>& tokens) {
+    // Regions are x,y,width,height separated by ';', followed by the
+    // processing to run on them, e.g. 'roi 0,0,640,360;640,0,640,360 haar face'
+    if (tokens.empty()) {
+        spdlog::error("You must provide at least one region");
+        return nullptr;
+    }
+    std::vector<cv::Rect> regions;
+    std::istringstream region_list(tokens.front());
+    std::string region;
+    while (std::getline(region_list, region, ';')) {
+        cv::Rect rect;
+        char comma[3] = {};
+        std::istringstream fields(region);
+        if (!(fields >> rect.x >> comma[0] >> rect.y >> comma[1] >>
+              rect.width >> comma[2] >> rect.height) ||
+            comma[0] != ',' || comma[1] != ',' || comma[2] != ',' ||
+            rect.empty()) {
+            spdlog::error("Invalid region: {}", region);
+            return nullptr;
+        }
+        regions.push_back(rect);
+    }
+    tokens.erase(tokens.begin());
+    if (regions.empty()) {
+        spdlog::error("You must provide at least one region");
+        return nullptr;
+    }
+
+    auto inner_factory = ParseTransformerTokens(tokens);
+    if (!inner_factory) {
+        return nullptr;
+    }
+    return std::make_shared<RoiTransformerFactory>(regions, inner_factory);
+}
+
+std::shared_ptr<VideoTransformerFactory> App::ParseTransformerChainTokens(
+    std::vector<std::string>& tokens) {
+    // Links are separated by '+', e.g. 'chain gray + haar face'
+    std::vector<TransformerChainLink> links;
+    while (!tokens.empty()) {
+        auto separator = std::find(tokens.begin(), tokens.end(), "+");
+        std::vector<std::string> link_tokens(tokens.begin(), separator);
+        tokens.erase(tokens.begin(),
+                     separator == tokens.end() ? separator : separator + 1);
+
+        std::string name;
+        for (auto& link_token : link_tokens) {
+            name += (name.empty() ? "" : " ") + link_token;
+        }
+        auto factory = ParseTransformerTokens(link_tokens);
+        if (!factory) {
+            return nullptr;
+        }
+        links.emplace_back(name, factory);
+    }
+    if (links.empty()) {
+        spdlog::error("A chain needs at least one link");
+        return nullptr;
+    }
+    return std::make_shared<TransformerChainFactory>(links);
+}
+
+void App::ParseOutputTokens(std::vector<std::string>& tokens) {
+    if (tokens.empty()) {
+        Help("output");
+        return;
+    }
+
+    auto output_type = tokens.front();
+    tokens.erase(tokens.begin());
+    if (!tokens.empty() && tokens.front() == "stop") {
+        RemoveOutput(output_type);
+        return;
+    }
+
+    // A rate limited output is named after the output it wraps, so e.g.
+    // 'output player stop' stops 'output rate 15fps player'
+    auto output_name = output_type;
+    if (output_type == "rate" && tokens.size() > 1) {
+        output_name = tokens[1];
+    }
+    auto consumer_factory =
+        ParseConsumerTokens(output_type, tokens, "Video Player (output)");
+    if (consumer_factory) {
+        AddOutput(output_name, consumer_factory);
+    }
+}
+
+std::shared_ptr<VideoConsumerFactory> App::ParseConsumerTokens(
+    const std::string& output_type, std::vector<std::string>& tokens,
+    const std::string& window_name) {
+    if (output_type == "rate") {
+        RateLimit limit;
+        if (!ParseRateTokens(tokens, limit)) {
+            return nullptr;
+        }
+        if (tokens.empty()) {
+            spdlog::error("You must provide an output type");
+            return nullptr;
+        }
+        auto inner_type = tokens.front();
+        tokens.erase(tokens.begin());
+        auto inner_factory =
+            ParseConsumerTokens(inner_type, tokens, window_name);
+        if (!inner_factory) {
+            return nullptr;
+        }
+        // Named like the output, e.g. 'player', as in ParseOutputTokens
+        return std::make_shared<RateLimitedConsumerFactory>(
+            limit, inner_factory, inner_type);
+    } else if (output_type == "player") {
+        return std::make_shared<VideoPlayerFactory>(window_name);
+    } else if (output_type == "record") {
+        if (tokens.empty()) {
+            spdlog::error("You must provide a filename");
+            return nullptr;
+        }
+        auto filename = tokens.front();
+        tokens.erase(tokens.begin());
+
+        VideoRecorderConfig config;
+        config.filename = filename;
+        if (!tokens.empty()) {
+            int minutes = 0;
+            try {
+                minutes = std::stoi(tokens.front());
+            } catch (const std::exception&) {
+                minutes = 0;
+            }
+            if (minutes <= 0) {
+                spdlog::error(
+                    "Invalid segment length: {}, expected a number of minutes",
+                    tokens.front());
+                return nullptr;
+            }
+            config.segment_duration = RecorderSegmentMinutes(minutes);
+            tokens.erase(tokens.begin());
+        }
+        if (!tokens.empty()) {
+            if (tokens.front() == "drop_oldest") {
+                config.drop_policy = RecorderDropPolicy::DROP_OLDEST;
+            } else if (tokens.front() == "drop_newest") {
+                config.drop_policy = RecorderDropPolicy::DROP_NEWEST;
+            } else {
+                spdlog::error("Invalid drop policy: {}", tokens.front());
+                return nullptr;
+            }
+            tokens.erase(tokens.begin());
+        }
+        return std::make_shared<VideoRecorderFactory>(config);
+    } else if (output_type == "shm") {
+        std::string name = kShmFrameRingDefaultName;
+        std::uint32_t slot_count = 4;
+        if (!tokens.empty()) {
+            name = tokens.front();
+            tokens.erase(tokens.begin());
+        }
+        if (name.front() != '/') {
+            name = "/" + name;
+        }
+        if (!tokens.empty()) {
+            int slots;
+            if (!ParsePositiveInt(tokens.front(), slots) ||
+                slots < static_cast<int>(kShmFramePublisherMinSlots) ||
+                slots > static_cast<int>(kShmFramePublisherMaxSlots)) {
+                spdlog::error("Invalid slot count: {}, expected {} to {}",
+                              tokens.front(), kShmFramePublisherMinSlots,
+                              kShmFramePublisherMaxSlots);
+                return nullptr;
+            }
+            slot_count = static_cast<std::uint32_t>(slots);
+            tokens.erase(tokens.begin());
+        }
+        return std::make_shared<ShmFramePublisherFactory>(name, slot_count);
+    } else if (output_type == "mjpeg") {
+        MjpegServerConfig config;
+        if (!tokens.empty()) {
+            if (!ParsePort(tokens.front(), config.port)) {
+                spdlog::error("Invalid port: {}, expected 1 to 65535",
+                              tokens.front());
+                return nullptr;
+            }
+            tokens.erase(tokens.begin());
+        }
+        return std::make_shared<MjpegServerFactory>(config);
+    } else {
+        spdlog::error(
+            "Invalid command. Type 'output' to see a list of the valid output "
+            "commands");
+        return nullptr;
+    }
+}
+
+void App::ParsePipelineTokens(std::vector<std::string>& tokens) {
+    if (tokens.empty()) {
+        Help("pipeline");
+        return;
+    }
+
+    auto token = tokens.front();
+    tokens.erase(tokens.begin());
+
+    if (token == "list") {
+        ListPipelines();
+        return;
+    }
+
+    if (tokens.empty()) {
+        spdlog::error("You must provide a pipeline name");
+        return;
+    }
+    auto name = tokens.front();
+    tokens.erase(tokens.begin());
+
+    if (token == "create") {
+        auto source_factory = ParseSourceTokens(tokens);
+        auto period_ms = TaskUpdatePeriodMs(33);
+        if (!source_factory || !ParsePeriodTokens(tokens, period_ms)) {
+            return;
+        }
+        auto pipeline = pipeline_manager_.Create(
+            name, source_factory,
+            std::make_shared<ColorspaceTransformerFactory>(), period_ms);
+        if (pipeline) {
+            pipeline->AddConsumer(
+                std::make_shared<VideoPlayerFactory>("Pipeline " + name));
+        }
+    } else if (token == "graph") {
+        if (tokens.empty()) {
+            spdlog::error("You must provide a pipeline graph file");
+            return;
+        }
+        auto filename = tokens.front();
+        tokens.erase(tokens.begin());
+        auto period_ms = TaskUpdatePeriodMs(33);
+        if (!ParsePeriodTokens(tokens, period_ms)) {
+            return;
+        }
+        CreateGraphPipeline(name, filename, period_ms);
+    } else if (token == "destroy") {
+        pipeline_manager_.Destroy(name);
+    } else if (token == "start") {
+        pipeline_manager_.Start(name);
+    } else if (token == "stop") {
+        pipeline_manager_.Stop(name);
+    } else if (token == "schedule") {
+        auto pipeline = pipeline_manager_.Find(name);
+        if (!pipeline) {
+            return;
+        }
+        auto schedule = pipeline->GetSchedule();
+        if (!tokens.empty()) {
+            // A budget below zero puts the deadline before capture
+            int budget_ms;
+            if (!ParsePositiveInt(tokens.front(), budget_ms)) {
+                spdlog::error("Invalid latency budget: {}, expected ms",
+                              tokens.front());
+                return;
+            }
+            schedule.latency_budget = LatencyBudgetMs(budget_ms);
+            tokens.erase(tokens.begin());
+        }
+        if (!tokens.empty()) {
+            // Shedding ranks frames by weight, which NaN would break
+            double weight = 0.0;
+            try {
+                std::size_t end;
+                weight = std::stod(tokens.front(), &end);
+                if (end != tokens.front().size()) {
+                    weight = 0.0;
+                }
+            } catch (const std::exception&) {
+                weight = 0.0;
+            }
+            if (!std::isfinite(weight) || weight <= 0.0) {
+                spdlog::error("Invalid weight: {}, expected more than 0",
+                              tokens.front());
+                return;
+            }
+            schedule.weight = weight;
+            tokens.erase(tokens.begin());
+        }
+        if (!tokens.empty()) {
+            if (tokens.front() == "high") {
+                schedule.priority = StreamPriority::HIGH;
+            } else if (tokens.front() == "best_effort") {
+                schedule.priority = StreamPriority::BEST_EFFORT;
+            } else {
+                spdlog::error("Invalid stream priority: {}", tokens.front());
+                return;
+            }
+        }
+        pipeline->SetSchedule(schedule);
+    } else if (token == "input") {
+        auto pipeline = FindLinearPipeline(name);
+        auto source_factory = pipeline ? ParseSourceTokens(tokens) : nullptr;
+        if (source_factory) {
+            pipeline->ChangeSource(source_factory);
+        }
+    } else if (token == "processing") {
+        auto pipeline = FindLinearPipeline(name);
+        auto transformer_factory =
+            pipeline ? ParseTransformerTokens(tokens) : nullptr;
+        if (transformer_factory) {
+            pipeline->ChangeTransformer(transformer_factory);
+        }
+    } else if (token == "output") {
+        auto pipeline = FindLinearPipeline(name);
+        if (!pipeline || tokens.empty()) {
+            Help("output");
+            return;
+        }
+        auto output_type = tokens.front();
+        tokens.erase(tokens.begin());
+        if (output_type == "clear") {
+            pipeline->RemoveConsumers();
+            return;
+        }
+        auto consumer_factory =
+            ParseConsumerTokens(output_type, tokens, "Pipeline " + name);
+        if (consumer_factory) {
+            try {
+                pipeline->AddConsumer(consumer_factory);
+            } catch (const std::exception& e) {
+                spdlog::error("Failed to add {} output: {}", output_type,
+                              e.what());
+            }
+        }
+    } else {
+        spdlog::error(
+            "Invalid command. Type 'pipeline' to see a list of the valid "
+            "pipeline commands");
     }
 }
 
+bool App::ParsePeriodTokens(std::vector<std::string>& tokens,
+                            TaskUpdatePeriodMs& period_ms) {
+    if (tokens.empty()) {
+        return true;
+    }
+    // The dispatcher would spin on a period that rounds to zero
+    int fps;
+    if (!ParsePositiveInt(tokens.front(), fps) || fps > 1000) {
+        spdlog::error("Invalid frame rate: {}, expected 1 to 1000 fps",
+                      tokens.front());
+        return false;
+    }
+    period_ms = TaskUpdatePeriodMs(1000 / fps);
+    tokens.erase(tokens.begin());
+    return true;
+}
+
+bool App::ParseRateTokens(std::vector<std::string>& tokens,
+                          RateLimit& limit) {
+    // Either every Nth frame, e.g. '5', or a target rate, e.g. '15fps'
+    if (tokens.empty()) {
+        spdlog::error("You must provide a rate");
+        return false;
+    }
+    auto token = tokens.front();
+    try {
+        auto suffix = token.find("fps");
+        if (suffix != std::string::npos && suffix + 3 == token.size()) {
+            auto fps = std::stod(token.substr(0, suffix));
+            // A period that rounds to zero would mean no limit at all
+            auto period_us = fps > 0.0 ? 1.0e6 / fps : 0.0;
+            if (!(period_us >= 1.0)) {
+                throw std::invalid_argument("fps");
+            }
+            limit.min_period = std::chrono::microseconds(
+                static_cast<std::int64_t>(period_us));
+        } else {
+            auto every_n = std::stoi(token);
+            if (every_n <= 0) {
+                throw std::invalid_argument("every_n");
+            }
+            limit.every_n = static_cast<std::uint32_t>(every_n);
+        }
+    } catch (const std::exception&) {
+        spdlog::error("Invalid rate: {}", token);
+        return false;
+    }
+    tokens.erase(tokens.begin());
+    return true;
+}
+
+void App::CreateGraphPipeline(const std::string& name,
+                              const std::string& filename,
+                              TaskUpdatePeriodMs period_ms) {
+    // Graph nodes use the same syntax as the interactive commands
+    PipelineNodeFactories factories;
+    factories.source = [this](std::vector<std::string>& tokens) {
+        return ParseSourceTokens(tokens);
+    };
+    factories.transformer = [this](std::vector<std::string>& tokens) {
+        return ParseTransformerTokens(tokens);
+    };
+    factories.consumer = [this, name](std::vector<std::string>& tokens) {
+        std::shared_ptr<VideoConsumerFactory> consumer_factory;
+        if (!tokens.empty()) {
+            auto output_type = tokens.front();
+            tokens.erase(tokens.begin());
+            consumer_factory =
+                ParseConsumerTokens(output_type, tokens, "Pipeline " + name);
+        }
+        return consumer_factory;
+    };
+
+    if (pipeline_manager_.Exists(name)) {
+        return;
+    }
+    try {
+        auto config = LoadPipelineGraphConfig(filename);
+        pipeline_manager_.Add(std::make_shared<GraphPipeline>(
+            name, config, factories, period_ms));
+    } catch (const PipelineConfigException& e) {
+        spdlog::error("Failed to create pipeline {}: {}", name, e.what());
+    }
+}
+
+std::shared_ptr<LinearPipeline> App::FindLinearPipeline(
+    const std::string& name) {
+    auto pipeline = pipeline_manager_.Find(name);
+    auto linear_pipeline = std::dynamic_pointer_cast<LinearPipeline>(pipeline);
+    if (pipeline && !linear_pipeline) {
+        spdlog::error("Pipeline {} is a graph; edit its graph file instead",
+                      name);
+    }
+    return linear_pipeline;
+}
+
 void App::Throttle() {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<ProfiledMutex> lock(mutex_);
     cond_.wait_for(lock, task_.period_ms_);
 }
 
@@ -234,6 +938,12 @@ void App::Help() {
     spdlog::info(
         "  ('processing' or 'p')   : Set the processing strategy for the "
         "sensory processing pipeline");
+    spdlog::info(
+        "  ('output' or 'o')       : Add or remove outputs of the sensory "
+        "processing pipeline");
+    spdlog::info(
+        "  ('pipeline' or 'pl')    : Create and control additional "
+        "pipelines");
     spdlog::info(
         "  ('start')               : Start sensory processing pipeline");
     spdlog::info(
@@ -243,6 +953,30 @@ void App::Help() {
     spdlog::info(
         "  ('stats')               : Print out statistics for the sensory "
         "processing pipeline");
+    spdlog::info(
+        "  ('stats file [on|off]')  : Also write the statistics to "
+        "diagnostics/diagnostics_out.txt every second");
+    spdlog::info(
+        "  ('metrics [port]')      : Serve Prometheus metrics on "
+        "http://127.0.0.1:<port>/metrics (default 9464)");
+    spdlog::info(
+        "  ('metrics unix <path>') : Serve Prometheus metrics on a UNIX "
+        "socket");
+    spdlog::info("  ('metrics stop')        : Stop serving metrics");
+    spdlog::info(
+        "  ('flight [deadline_ms] [margin_ms]'): Dump the flight recorder "
+        "when a frame is late by more than the margin");
+    spdlog::info(
+        "  ('flight dump')         : Dump the flight recorder now");
+    spdlog::info(
+        "  ('perf on|off')          : Count cycles, cache misses, context "
+        "switches and more per frame of each stage");
+    spdlog::info(
+        "  ('trace start')         : Start recording a trace of every "
+        "stage");
+    spdlog::info(
+        "  ('trace stop [file]')   : Stop and write a Chrome trace, "
+        "trace.json by default");
 }
 
 void App::Help(const std::string help_type) {
@@ -250,6 +984,9 @@ void App::Help(const std::string help_type) {
         spdlog::info("Input Commands:");
         spdlog::info("  ('webcam')               : Set video source to webcam");
         spdlog::info("  ('file <filename.mp4>')  : Set video source to file");
+        spdlog::info(
+            "  ('format <bgr|i420>')    : Set the frame format passed "
+            "between stages");
     } else if (help_type == "processing") {
         spdlog::info("Processing Commands:");
         spdlog::info(
@@ -259,6 +996,69 @@ void App::Help(const std::string help_type) {
         spdlog::info(
             "  ('haar')                 : Object detection using a haar "
             "cascade classifier");
+        spdlog::info(
+            "  ('threshold [level] [gain]'): Show the pixels brighter than "
+            "level");
+        spdlog::info(
+            "  ('chain <a> + <b> ...')  : Run several processing steps in "
+            "order, e.g. 'chain gray + haar face'");
+        spdlog::info(
+            "  ('roi <x,y,w,h>[;...] <processing>'): Run processing on "
+            "regions of the frame only");
+        spdlog::info(
+            "  ('rate <n|Nfps> <processing>'): Run analysis on every Nth "
+            "frame or at N fps, e.g. 'rate 5 haar body'");
+    } else if (help_type == "output") {
+        spdlog::info("Output Commands:");
+        spdlog::info(
+            "  ('record <filename.avi> [segment_minutes] [drop_oldest|"
+            "drop_newest]')");
+        spdlog::info(
+            "                           : Record the video to file, starting "
+            "a new file every segment_minutes");
+        spdlog::info("  ('record stop')          : Stop recording");
+        spdlog::info(
+            "  ('shm [name] [slots]')   : Publish frames to a shared memory "
+            "ring for other processes");
+        spdlog::info(
+            "  ('shm stop')             : Stop publishing to shared memory");
+        spdlog::info(
+            "  ('mjpeg [port]')         : Serve an MJPEG preview on "
+            "http://127.0.0.1:<port>/");
+        spdlog::info("  ('mjpeg stop')           : Stop the MJPEG preview");
+        spdlog::info(
+            "  ('player')               : Show the video in another window");
+        spdlog::info(
+            "  ('rate <n|Nfps> <output>'): Pass every Nth frame or N fps to "
+            "an output, e.g. 'rate 15fps player'");
+    } else if (help_type == "pipeline") {
+        spdlog::info("Pipeline Commands:");
+        spdlog::info("  ('create <name> webcam [fps]')");
+        spdlog::info("  ('create <name> file <filename.mp4> [fps]')");
+        spdlog::info(
+            "                           : Create a pipeline that shows its "
+            "video in a player window");
+        spdlog::info("  ('graph <name> <file.pipeline> [fps]')");
+        spdlog::info(
+            "                           : Create a pipeline from a graph "
+            "file (see assets/config)");
+        spdlog::info("  ('destroy <name>')       : Destroy a pipeline");
+        spdlog::info("  ('start <name>')         : Start a pipeline");
+        spdlog::info("  ('stop <name>')          : Stop a pipeline");
+        spdlog::info(
+            "  ('input <name> ...')     : Set the input source (see 'input')");
+        spdlog::info(
+            "  ('processing <name> ...'): Set the processing (see "
+            "'processing')");
+        spdlog::info(
+            "  ('output <name> ...')    : Add an output (see 'output'), or "
+            "'clear' to remove them all");
+        spdlog::info(
+            "  ('schedule <name> <budget_ms> [weight] [high|best_effort]')");
+        spdlog::info(
+            "                           : Set the latency budget and "
+            "scheduling class of a pipeline");
+        spdlog::info("  ('list')                 : List all pipelines");
     } else if (help_type == "processing haar") {
         spdlog::info("Haar Cascade Classifier Commands:");
         spdlog::info("  ('eyes')                 : Draw a box around eyes");
@@ -290,6 +1090,9 @@ void App::Help(const std::string help_type) {
         spdlog::info(
             "  ('cat_face_ext')         : Draw boxes around cat faces "
             "(extended)");
+        spdlog::info(
+            "  Any of these can be followed by a height, e.g. 'face 480', to "
+            "detect on a scaled down frame");
     }
 
     else {
@@ -316,44 +1119,50 @@ void App::Stop() {
 }
 
 void App::PrintStats() {
-    std::string diagnostics_file = "diagnostics/diagnostics_out.txt";
-
-    // Open the file
-    std::ifstream file(diagnostics_file);
-
-    // Check if the file is open
-    if (!file.is_open()) {
-        spdlog::error("Failed to open file: {}", diagnostics_file);
-    }
-
-    // Read and log each line of the file
+    // Read straight from memory, so the numbers are current rather than as of
+    // the last diagnostics period
+    std::ostringstream text;
+    WriteMetricsText(MetricsRegistry::instance().Snapshot(), text);
+    std::istringstream lines(text.str());
     std::string line;
-    while (std::getline(file, line)) {
+    while (std::getline(lines, line)) {
         spdlog::info(line);
     }
-
-    // Close the file
-    file.close();
 }
 
-void App::SetSourceWebcam() {
-    video_input_.ChangeSource(
-        std::make_shared<VideoSourceFactory>(VideoSourceType::WEBCAM));
-}
-
-void App::SetSourceVideoFile(const std::string filename) {
-    video_input_.ChangeSource(
-        std::make_shared<VideoSourceFactory>(VideoSourceType::FILE, filename));
+void App::AddOutput(const std::string& output_type,
+                    std::shared_ptr<VideoConsumerFactory> consumer_factory) {
+    RemoveOutput(output_type);
+    try {
+        outputs_[output_type] = video_output_.AddConsumer(consumer_factory);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to add {} output: {}", output_type, e.what());
+    }
 }
 
-void App::SetTransformerColorspace(Colorspace colorspace) {
-    video_processor_.ChangeTransformer(
-        std::make_shared<ColorspaceTransformerFactory>(colorspace));
+void App::RemoveOutput(const std::string& output_type) {
+    auto it = outputs_.find(output_type);
+    if (it != outputs_.end()) {
+        video_output_.RemoveConsumer(it->second);
+        outputs_.erase(it);
+    }
 }
 
-void App::SetTrasformerHaarCascadeClassifier(HaarCascadeClassifierType type) {
-    video_processor_.ChangeTransformer(
-        std::make_shared<HaarCascadeClassifierFactory>(type));
+void App::ListPipelines() {
+    auto pipelines = pipeline_manager_.List();
+    if (pipelines.empty()) {
+        spdlog::info("No pipelines");
+    }
+    for (auto& pipeline : pipelines) {
+        auto schedule = pipeline->GetSchedule();
+        spdlog::info(
+            "  {} ({}, {} ms period, {} ms budget, weight {}, {})",
+            pipeline->Name(), pipeline->IsRunning() ? "running" : "stopped",
+            pipeline->period_ms_.count(), schedule.latency_budget.count(),
+            schedule.weight,
+            schedule.priority == StreamPriority::HIGH ? "high"
+                                                      : "best effort");
+    }
 }
 
 void App::Quit() {
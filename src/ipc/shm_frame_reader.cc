@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Filename:    shm_frame_reader.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "shm_frame_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include "error_handling.h"
+
+ShmFrameReader::~ShmFrameReader() { Close(); }
+
+bool ShmFrameReader::Open() {
+    if (IsOpen()) {
+        return true;
+    }
+
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        // The publisher has not created the ring yet
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(ShmFrameRingHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* address =
+        mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw ShmTransportException("Failed to map frame ring " + name_ +
+                                    ": " + strerror(errno));
+    }
+
+    auto* ring = static_cast<ShmFrameRingHeader*>(address);
+    // The publisher sets the magic number last, so a ring that is still being
+    // created or replaced isn't ready yet rather than incompatible
+    if (ring->magic != kShmFrameRingMagic) {
+        munmap(address, info.st_size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (ring->version != kShmFrameRingVersion ||
+        ShmFrameRingSize(ring->slot_count, ring->slot_capacity) >
+            static_cast<std::size_t>(info.st_size)) {
+        munmap(address, info.st_size);
+        throw ShmTransportException("Incompatible frame ring layout: " +
+                                    name_);
+    }
+
+    ring_ = ring;
+    mapped_size_ = info.st_size;
+    last_sequence_ = 0;
+    generation_ = ring->generation;
+    return true;
+}
+
+void ShmFrameReader::Close() {
+    if (ring_ != nullptr) {
+        munmap(ring_, mapped_size_);
+        ring_ = nullptr;
+        mapped_size_ = 0;
+    }
+}
+
+bool ShmFrameReader::AcquireLatest(ShmFrameView& view) {
+    if (!IsOpen()) {
+        return false;
+    }
+    // The publisher clears the magic number before it removes the ring,
+    // including when it replaces it with a larger one; reopen to follow it
+    if (ring_->magic != kShmFrameRingMagic) {
+        Close();
+        return false;
+    }
+
+    auto latest = ring_->latest_sequence.load(std::memory_order_acquire);
+    if (latest == 0 || latest == last_sequence_) {
+        return false;
+    }
+
+    auto* slot = ShmFrameRingSlot(ring_, latest);
+    auto seqlock = slot->seqlock.load(std::memory_order_acquire);
+    if (seqlock & 1) {
+        // The publisher has already lapped the ring and is rewriting the slot
+        return false;
+    }
+
+    view.sequence = slot->sequence;
+    view.timestamp_ns = slot->timestamp_ns;
+    view.size = slot->size;
+    view.step = slot->step;
+    view.rows = slot->rows;
+    view.cols = slot->cols;
+    view.type = slot->type;
+    view.data = ShmFrameRingSlotData(slot);
+    view.slot_ = slot;
+    view.seqlock_ = seqlock;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seqlock.load(std::memory_order_relaxed) != seqlock ||
+        view.sequence != latest || view.size > ring_->slot_capacity) {
+        return false;
+    }
+
+    if (last_sequence_ != 0 && latest > last_sequence_ + 1) {
+        frames_skipped_ += latest - last_sequence_ - 1;
+    }
+    last_sequence_ = latest;
+    return true;
+}
+
+bool ShmFrameReader::IsValid(const ShmFrameView& view) const {
+    if (view.slot_ == nullptr) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot_->seqlock.load(std::memory_order_relaxed) ==
+           view.seqlock_;
+}
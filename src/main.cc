@@ -12,11 +12,13 @@
 #include <condition_variable>
 #include <csignal>
 #include <mutex>
+#include <string>
 
 #include "app.h"
 #include "error_handling.h"
 #include "logger.h"
 #include "task.h"
+#include "task_scheduling.h"
 
 // Used to gracefully shutdown tasks
 std::atomic<bool> shutting_down(false);
@@ -39,6 +41,16 @@ int main(int argc, char *argv[]) {
     std::signal(SIGINT, SignalHandler);
 
     try {
+        // spp_app [--scheduling <file>]
+        for (int i = 1; i < argc; i++) {
+            if (std::string(argv[i]) == "--scheduling" && i + 1 < argc) {
+                SetTaskSchedulingProfiles(LoadTaskSchedulingConfig(argv[++i]));
+            } else {
+                spdlog::error("Usage: {} [--scheduling <file>]", argv[0]);
+                return 1;
+            }
+        }
+
         App app(TaskId::APP, TaskPriority::APP, TaskUpdatePeriodMs(100),
                 shutting_down, shutdown_cv);
         app.Init();
@@ -0,0 +1,354 @@
+/******************************************************************************
+ * Filename:    graph_pipeline.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "graph_pipeline.h"
+
+#include <algorithm>
+#include <map>
+
+#include "error_handling.h"
+#include "flight_recorder.h"
+#include "logger.h"
+#include "opencv2/imgproc.hpp"
+
+// The state of one frame as it moves through the graph. Every submitted node
+// holds a reference on the run; the frame is finished when the last one
+// releases it.
+struct GraphPipeline::FrameRun {
+    FrameRun(std::shared_ptr<GraphPipeline> pipeline, std::size_t node_count)
+        : pipeline(std::move(pipeline)),
+          outstanding(0),
+          produced(false),
+          readers_pending(node_count),
+          join_pending(node_count),
+          join_inputs(node_count) {}
+
+    std::shared_ptr<GraphPipeline> pipeline;
+    SchedulerClock::time_point start_time;
+    SchedulerClock::time_point deadline;
+    StreamSchedule schedule;
+    std::atomic<int> outstanding;
+    std::atomic<bool> produced;
+    std::vector<std::atomic<int>> readers_pending;
+    std::vector<std::atomic<int>> join_pending;
+    std::vector<std::vector<cv::Mat>> join_inputs;
+};
+
+GraphPipeline::GraphPipeline(const PipelineName& name,
+                             const PipelineGraphConfig& config,
+                             const PipelineNodeFactories& factories,
+                             TaskUpdatePeriodMs period_ms)
+    : Pipeline(name, period_ms), worker_pool_(nullptr), branches_shed_(0) {
+    std::map<std::string, std::size_t> indices;
+    nodes_.reserve(config.nodes.size());
+    for (auto& node_config : config.nodes) {
+        auto index = nodes_.size();
+        nodes_.emplace_back();
+        auto& node = nodes_.back();
+        node.type = node_config.type;
+        node.name = node_config.name;
+        node.time_stats = std::make_unique<StatisticsQueue<double>>(100);
+        for (auto& input : node_config.inputs) {
+            node.inputs.push_back(indices.at(input));
+        }
+        indices[node.name] = index;
+
+        auto tokens = node_config.tokens;
+        auto error = "line " + std::to_string(node_config.line) + ": " +
+                     "invalid " + node.name;
+        try {
+            switch (node.type) {
+                case PipelineNodeType::SOURCE: {
+                    auto factory = factories.source(tokens);
+                    if (!factory) {
+                        throw PipelineConfigException(error);
+                    }
+                    node.reader =
+                        std::make_shared<SourceReader>(factory->Create());
+                    sources_.push_back(index);
+                    break;
+                }
+                case PipelineNodeType::TRANSFORM: {
+                    auto factory = factories.transformer(tokens);
+                    if (!factory) {
+                        throw PipelineConfigException(error);
+                    }
+                    node.transformer = factory->Create();
+                    break;
+                }
+                case PipelineNodeType::SINK: {
+                    auto factory = factories.consumer(tokens);
+                    if (!factory) {
+                        throw PipelineConfigException(error);
+                    }
+                    node.consumer = factory->Create();
+                    break;
+                }
+                case PipelineNodeType::JOIN:
+                    break;
+            }
+        } catch (const PipelineConfigException&) {
+            throw;
+        } catch (const std::exception& e) {
+            throw PipelineConfigException(error + ": " + e.what());
+        }
+
+        for (auto input : node.inputs) {
+            auto& parent = nodes_[input];
+            switch (node.type) {
+                case PipelineNodeType::TRANSFORM:
+                    parent.transforms.push_back(index);
+                    break;
+                case PipelineNodeType::JOIN:
+                    parent.joins.push_back(index);
+                    break;
+                case PipelineNodeType::SINK:
+                    parent.sinks.push_back(index);
+                    break;
+                case PipelineNodeType::SOURCE:
+                    break;
+            }
+        }
+    }
+}
+
+GraphPipeline::~GraphPipeline() {
+    for (auto index : sources_) {
+        nodes_[index].reader->Stop();
+        nodes_[index].reader->Close();
+    }
+}
+
+void GraphPipeline::OpenSources() {
+    for (auto index : sources_) {
+        nodes_[index].reader->Open();
+        nodes_[index].reader->Start();
+    }
+}
+
+void GraphPipeline::DispatchFrame(SchedulerClock::time_point deadline,
+                                  WorkerPool& worker_pool) {
+    worker_pool_ = &worker_pool;
+    auto run = std::make_shared<FrameRun>(
+        std::static_pointer_cast<GraphPipeline>(shared_from_this()),
+        nodes_.size());
+    run->start_time = SchedulerClock::now();
+    run->deadline = deadline;
+    run->schedule = GetSchedule();
+    for (std::size_t i = 0; i < nodes_.size(); i++) {
+        run->join_pending[i] = static_cast<int>(nodes_[i].inputs.size());
+        if (nodes_[i].type == PipelineNodeType::JOIN) {
+            run->join_inputs[i].resize(nodes_[i].inputs.size());
+        }
+    }
+
+    // Hold a reference while submitting so a fast source can't finish the
+    // frame before the others are queued. Each source is read on its own
+    // reader thread, which then queues the source node with the frame.
+    run->outstanding++;
+    for (auto index : sources_) {
+        run->outstanding++;
+        nodes_[index].reader->Request([run, index](cv::Mat frame) {
+            run->pipeline->Submit(run, index, std::move(frame));
+            run->pipeline->Release(run);
+        });
+    }
+    Release(run);
+}
+
+void GraphPipeline::Submit(const std::shared_ptr<FrameRun>& run,
+                           std::size_t index, cv::Mat frame) {
+    run->outstanding++;
+    ScheduledWork work;
+    work.run = [run, index, frame]() mutable {
+        run->pipeline->RunNode(run, index, frame);
+        run->pipeline->Release(run);
+    };
+    work.shed = [run, index, frame]() mutable {
+        run->pipeline->ShedNode(run, index, frame);
+        run->pipeline->Release(run);
+    };
+    work.deadline = run->deadline;
+    work.priority = run->schedule.priority;
+    work.weight = run->schedule.weight;
+    worker_pool_->Submit(std::move(work));
+}
+
+void GraphPipeline::Release(const std::shared_ptr<FrameRun>& run) {
+    if (--run->outstanding == 0) {
+        FinishFrame(run->start_time, run->deadline, run->produced);
+    }
+}
+
+void GraphPipeline::RunNode(const std::shared_ptr<FrameRun>& run,
+                            std::size_t index, cv::Mat& frame) {
+    auto& node = nodes_[index];
+    auto start_time = std::chrono::high_resolution_clock::now();
+    switch (node.type) {
+        case PipelineNodeType::SOURCE:
+            // Read by the source's reader
+            if (!IsRunning()) {
+                frame = cv::Mat();
+            }
+            break;
+        case PipelineNodeType::TRANSFORM:
+            node.transformer->Transform(frame);
+            break;
+        case PipelineNodeType::JOIN:
+            ComposeJoin(run, index);
+            frame = node.buffer;
+            break;
+        case PipelineNodeType::SINK:
+            if (node.consumer->WantsFrame()) {
+                node.consumer->Consume(frame);
+            }
+            break;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               end_time - start_time)
+                               .count();
+    node.time_stats->Push(static_cast<double>(elapsed_time_ns) * 1.0e-9);
+
+    if (node.type == PipelineNodeType::SINK) {
+        ReaderDone(run, node.inputs.front(), frame);
+    } else {
+        Emit(run, index, frame);
+    }
+}
+
+void GraphPipeline::ShedNode(const std::shared_ptr<FrameRun>& run,
+                             std::size_t index, cv::Mat& frame) {
+    branches_shed_++;
+    FlightRecorder::instance().Record("pipeline", "branch shed", 0, 1.0,
+                                      Name());
+    auto& node = nodes_[index];
+    if (node.type == PipelineNodeType::SINK) {
+        ReaderDone(run, node.inputs.front(), frame);
+    } else {
+        // Everything downstream of a shed node sees an empty frame
+        cv::Mat empty;
+        Emit(run, index, empty);
+    }
+}
+
+void GraphPipeline::Emit(const std::shared_ptr<FrameRun>& run,
+                         std::size_t index, cv::Mat& frame) {
+    auto& node = nodes_[index];
+    if (!frame.empty()) {
+        run->produced = true;
+    }
+
+    for (auto join : node.joins) {
+        auto& inputs = nodes_[join].inputs;
+        auto slot = std::find(inputs.begin(), inputs.end(), index) -
+                    inputs.begin();
+        run->join_inputs[join][slot] = frame;
+        if (--run->join_pending[join] == 0) {
+            Submit(run, join, cv::Mat());
+        }
+    }
+
+    if (frame.empty()) {
+        for (auto transform : node.transforms) {
+            cv::Mat empty;
+            Emit(run, transform, empty);
+        }
+        return;
+    }
+
+    if (node.sinks.empty()) {
+        DispatchWriters(run, index, frame);
+        return;
+    }
+    run->readers_pending[index] = static_cast<int>(node.sinks.size());
+    for (auto sink : node.sinks) {
+        Submit(run, sink, frame);
+    }
+}
+
+void GraphPipeline::ReaderDone(const std::shared_ptr<FrameRun>& run,
+                               std::size_t index, cv::Mat& frame) {
+    if (--run->readers_pending[index] == 0) {
+        DispatchWriters(run, index, frame);
+    }
+}
+
+void GraphPipeline::DispatchWriters(const std::shared_ptr<FrameRun>& run,
+                                    std::size_t index, cv::Mat& frame) {
+    auto& node = nodes_[index];
+    for (std::size_t i = 0; i < node.transforms.size(); i++) {
+        auto& child = nodes_[node.transforms[i]];
+        // A join may still be reading the frame, so it can only be handed
+        // over when nothing else will look at it again
+        bool exclusive = i + 1 == node.transforms.size() && node.joins.empty();
+        if (exclusive) {
+            Submit(run, node.transforms[i], frame);
+        } else {
+            frame.copyTo(child.buffer);
+            Submit(run, node.transforms[i], child.buffer);
+        }
+    }
+}
+
+void GraphPipeline::ComposeJoin(const std::shared_ptr<FrameRun>& run,
+                                std::size_t index) {
+    auto& node = nodes_[index];
+    std::vector<cv::Mat> tiles;
+    for (auto& input : run->join_inputs[index]) {
+        if (input.empty()) {
+            continue;
+        }
+        if (tiles.empty()) {
+            tiles.push_back(input);
+            continue;
+        }
+
+        // Match the first input so the tiles can be placed side by side
+        auto& first = tiles.front();
+        cv::Mat tile = input;
+        if (tile.channels() != first.channels()) {
+            cv::Mat converted;
+            cv::cvtColor(tile, converted,
+                         first.channels() == 1 ? cv::COLOR_BGR2GRAY
+                                               : cv::COLOR_GRAY2BGR);
+            tile = converted;
+        }
+        if (tile.rows != first.rows) {
+            cv::Mat resized;
+            auto cols = tile.cols * first.rows / tile.rows;
+            cv::resize(tile, resized, cv::Size(cols, first.rows));
+            tile = resized;
+        }
+        tiles.push_back(tile);
+    }
+    run->join_inputs[index].assign(node.inputs.size(), cv::Mat());
+
+    if (tiles.empty()) {
+        node.buffer.release();
+    } else if (tiles.size() == 1) {
+        // The input is still shared with its other readers
+        tiles.front().copyTo(node.buffer);
+    } else {
+        cv::hconcat(tiles, node.buffer);
+    }
+}
+
+void GraphPipeline::ReportComponentDiagnostics(const std::string& prefix,
+                                               DiagnosticsReport& report) {
+    for (auto& node : nodes_) {
+        report.AddTimeStatistics(prefix + node.name + " Time",
+                                 node.time_stats->GetStatistics());
+        DiagnosticsReport node_report;
+        if (node.transformer) {
+            node.transformer->ReportDiagnostics(node_report);
+        }
+        if (node.consumer) {
+            node.consumer->ReportDiagnostics(node_report);
+        }
+        AddPrefixedDiagnostics(prefix + node.name + " ", node_report, report);
+    }
+    report.AddCounter(prefix + "Branches Shed", branches_shed_);
+}
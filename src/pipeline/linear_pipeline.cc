@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Filename:    linear_pipeline.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "linear_pipeline.h"
+
+#include "logger.h"
+
+LinearPipeline::LinearPipeline(
+    const PipelineName& name,
+    std::shared_ptr<VideoSourceFactory> source_factory,
+    std::shared_ptr<VideoTransformerFactory> transformer_factory,
+    TaskUpdatePeriodMs period_ms)
+    : Pipeline(name, period_ms),
+      reader_(std::make_shared<SourceReader>(source_factory->Create())),
+      transformer_(transformer_factory->Create()),
+      output_format_(transformer_->OutputFormat(PixelFormat::BGR)) {}
+
+LinearPipeline::~LinearPipeline() {
+    reader_->Stop();
+    reader_->Close();
+}
+
+void LinearPipeline::OpenSources() {
+    reader_->Open();
+    reader_->Start();
+}
+
+void LinearPipeline::ChangeSource(
+    std::shared_ptr<VideoSourceFactory> new_source_factory) {
+    Stop();
+    reader_->SetSource(new_source_factory->Create());
+}
+
+void LinearPipeline::ChangeTransformer(
+    std::shared_ptr<VideoTransformerFactory> new_transformer_factory) {
+    auto transformer = new_transformer_factory->Create();
+    if (!transformer) {
+        return;
+    }
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    transformer_ = transformer;
+    output_format_ = transformer_->OutputFormat(PixelFormat::BGR);
+}
+
+std::shared_ptr<VideoConsumer> LinearPipeline::AddConsumer(
+    std::shared_ptr<VideoConsumerFactory> consumer_factory) {
+    auto consumer = consumer_factory->Create();
+    if (consumer) {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        consumers_.push_back(consumer);
+    }
+    return consumer;
+}
+
+void LinearPipeline::RemoveConsumers() {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    consumers_.clear();
+}
+
+void LinearPipeline::DispatchFrame(SchedulerClock::time_point deadline,
+                                   WorkerPool& worker_pool) {
+    // The work item keeps the pipeline alive if it is destroyed while the
+    // frame is queued
+    auto self = std::static_pointer_cast<LinearPipeline>(shared_from_this());
+    auto schedule = GetSchedule();
+    // Only the processing goes to the pool, once the frame is captured
+    reader_->Request([self, deadline, schedule,
+                      &worker_pool](cv::Mat frame) {
+        ScheduledWork work;
+        work.run = [self, deadline, frame]() mutable {
+            self->ProcessFrame(deadline, frame);
+        };
+        work.shed = [self] { self->ShedFrame(); };
+        work.deadline = deadline;
+        work.priority = schedule.priority;
+        work.weight = schedule.weight;
+        worker_pool.Submit(std::move(work));
+    });
+}
+
+void LinearPipeline::ProcessFrame(SchedulerClock::time_point deadline,
+                                  cv::Mat& frame) {
+    std::shared_ptr<VideoTransformer> transformer;
+    std::vector<std::shared_ptr<VideoConsumer>> consumers;
+    PixelFormat output_format;
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        transformer = transformer_;
+        consumers = consumers_;
+        output_format = output_format_;
+    }
+
+    auto start_time = SchedulerClock::now();
+    bool processed = false;
+    if (IsRunning()) {
+        if (!frame.empty()) {
+            views_.Reset(frame, PixelFormat::BGR);
+            transformer->Transform(frame, views_);
+            views_.DrawOverlays(frame);
+
+            // Consumers that need the same format share one conversion
+            views_.Reset(frame, output_format);
+            for (auto& consumer : consumers) {
+                if (!consumer->WantsFrame()) {
+                    continue;
+                }
+                consumer->Consume(views_.View(consumer->InputFormat(),
+                                              consumer->InputSize()));
+            }
+            views_.Clear();
+            processed = true;
+        }
+    }
+    FinishFrame(start_time, deadline, processed);
+}
+
+void LinearPipeline::ReportComponentDiagnostics(const std::string& prefix,
+                                                DiagnosticsReport& report) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    DiagnosticsReport transformer_report;
+    transformer_->ReportDiagnostics(transformer_report);
+    AddPrefixedDiagnostics(prefix, transformer_report, report);
+    for (auto& consumer : consumers_) {
+        DiagnosticsReport consumer_report;
+        consumer->ReportDiagnostics(consumer_report);
+        AddPrefixedDiagnostics(prefix, consumer_report, report);
+    }
+}
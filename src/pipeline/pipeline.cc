@@ -0,0 +1,102 @@
+/******************************************************************************
+ * Filename:    pipeline.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "pipeline.h"
+
+#include "flight_recorder.h"
+#include "logger.h"
+
+Pipeline::Pipeline(const PipelineName& name, TaskUpdatePeriodMs period_ms)
+    : period_ms_(period_ms),
+      next_frame_time_(PipelineClock::now()),
+      name_(name),
+      running_(false),
+      frame_in_flight_(false),
+      frames_processed_(0),
+      frames_skipped_(0),
+      frames_empty_(0),
+      frames_shed_(0),
+      deadline_misses_(0) {}
+
+void Pipeline::Start() {
+    OpenSources();
+    next_frame_time_ = PipelineClock::now();
+    running_ = true;
+}
+
+void Pipeline::Stop() { running_ = false; }
+
+void Pipeline::SetSchedule(const StreamSchedule& schedule) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    schedule_ = schedule;
+}
+
+StreamSchedule Pipeline::GetSchedule() {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    return schedule_;
+}
+
+bool Pipeline::TryBeginFrame() {
+    bool expected = false;
+    return frame_in_flight_.compare_exchange_strong(expected, true);
+}
+
+void Pipeline::ShedFrame() {
+    frames_shed_++;
+    FlightRecorder::instance().Record("pipeline", "shed", 0, 1.0, name_);
+    frame_in_flight_ = false;
+}
+
+void Pipeline::FinishFrame(SchedulerClock::time_point start_time,
+                           SchedulerClock::time_point deadline,
+                           bool processed) {
+    if (processed) {
+        auto end_time = SchedulerClock::now();
+        std::chrono::duration<double> elapsed_time = end_time - start_time;
+        time_stats_.Push(elapsed_time.count());
+        FlightRecorder::instance().Record("pipeline", "frame", 0,
+                                          elapsed_time.count(), name_);
+
+        // Negative lateness is slack left before the deadline
+        std::chrono::duration<double> lateness = end_time - deadline;
+        lateness_stats_.Push(lateness.count());
+        if (lateness.count() > 0) {
+            deadline_misses_++;
+            FlightRecorder::instance().CheckLateness("pipeline", 0,
+                                                     lateness.count(), name_);
+        }
+        frames_processed_++;
+    } else {
+        frames_empty_++;
+    }
+    frame_in_flight_ = false;
+}
+
+void Pipeline::AddPrefixedDiagnostics(const std::string& prefix,
+                                      const DiagnosticsReport& component_report,
+                                      DiagnosticsReport& report) {
+    for (auto& [name, statistics] : component_report.time_statistics) {
+        report.AddTimeStatistics(prefix + name, statistics);
+    }
+    for (auto& [name, value] : component_report.counters) {
+        report.AddCounter(prefix + name, value);
+    }
+    for (auto& [name, value] : component_report.values) {
+        report.AddValue(prefix + name, value);
+    }
+}
+
+void Pipeline::ReportDiagnostics(DiagnosticsReport& report) {
+    auto prefix = "Pipeline " + name_ + " ";
+    report.AddTimeStatistics(prefix + "Time", time_stats_.GetStatistics());
+    report.AddCounter(prefix + "Frames Processed", frames_processed_);
+    report.AddCounter(prefix + "Frames Skipped", frames_skipped_);
+    report.AddCounter(prefix + "Empty Frames", frames_empty_);
+    report.AddTimeStatistics(prefix + "Lateness",
+                             lateness_stats_.GetStatistics());
+    report.AddCounter(prefix + "Frames Shed", frames_shed_);
+    report.AddCounter(prefix + "Deadline Misses", deadline_misses_);
+    ReportComponentDiagnostics(prefix, report);
+}
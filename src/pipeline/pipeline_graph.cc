@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Filename:    pipeline_graph.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "pipeline_graph.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "error_handling.h"
+
+namespace {
+
+std::string ConfigError(const std::string& filename, int line,
+                        const std::string& message) {
+    return filename + ":" + std::to_string(line) + ": " + message;
+}
+
+std::vector<std::string> SplitInputs(const std::string& inputs) {
+    std::vector<std::string> names;
+    std::stringstream stream(inputs);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (!name.empty()) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+}  // namespace
+
+PipelineGraphConfig LoadPipelineGraphConfig(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw PipelineConfigException("Failed to open pipeline graph: " +
+                                      filename);
+    }
+
+    PipelineGraphConfig config;
+    std::map<std::string, PipelineNodeType> declared;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        auto comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::vector<std::string> tokens;
+        std::istringstream stream(line);
+        std::string token;
+        while (stream >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+        if (tokens.size() < 2) {
+            throw PipelineConfigException(
+                ConfigError(filename, line_number, "missing node name"));
+        }
+
+        PipelineNodeConfig node;
+        node.line = line_number;
+        node.name = tokens[1];
+        auto& kind = tokens[0];
+        std::size_t first_token = 2;
+        if (kind == "source") {
+            node.type = PipelineNodeType::SOURCE;
+        } else if (kind == "transform" || kind == "join" || kind == "sink") {
+            node.type = kind == "transform" ? PipelineNodeType::TRANSFORM
+                        : kind == "join"    ? PipelineNodeType::JOIN
+                                            : PipelineNodeType::SINK;
+            if (tokens.size() < 3) {
+                throw PipelineConfigException(ConfigError(
+                    filename, line_number, "missing input for " + node.name));
+            }
+            node.inputs = SplitInputs(tokens[2]);
+            first_token = 3;
+        } else {
+            throw PipelineConfigException(ConfigError(
+                filename, line_number, "unknown node type: " + kind));
+        }
+
+        if (declared.count(node.name) != 0) {
+            throw PipelineConfigException(ConfigError(
+                filename, line_number, "duplicate node: " + node.name));
+        }
+        if (node.type == PipelineNodeType::JOIN && node.inputs.size() < 2) {
+            throw PipelineConfigException(ConfigError(
+                filename, line_number, "a join needs at least two inputs"));
+        }
+        if (node.type != PipelineNodeType::JOIN && node.inputs.size() > 1) {
+            throw PipelineConfigException(ConfigError(
+                filename, line_number, "only a join may have several inputs"));
+        }
+        for (auto& input : node.inputs) {
+            auto it = declared.find(input);
+            if (it == declared.end()) {
+                throw PipelineConfigException(ConfigError(
+                    filename, line_number, "undeclared input: " + input));
+            }
+            if (it->second == PipelineNodeType::SINK) {
+                throw PipelineConfigException(ConfigError(
+                    filename, line_number, "a sink has no output: " + input));
+            }
+        }
+
+        node.tokens.assign(tokens.begin() + first_token, tokens.end());
+        declared[node.name] = node.type;
+        config.nodes.push_back(node);
+    }
+
+    if (config.nodes.empty()) {
+        throw PipelineConfigException("Pipeline graph is empty: " + filename);
+    }
+    return config;
+}
@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Filename:    pipeline_manager.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "pipeline_manager.h"
+
+#include <algorithm>
+
+#include "logger.h"
+
+PipelineManager::PipelineManager(TaskId id, TaskPriority priority,
+                                 TaskUpdatePeriodMs period_ms,
+                                 std::size_t worker_count,
+                                 std::atomic<bool>& shutting_down)
+    : task_(id, priority, period_ms, TaskFcn),
+      worker_pool_(TaskPriority::WORKER, worker_count),
+      shutting_down_(shutting_down) {
+    task_.SetData(this);
+}
+
+PipelineManager::~PipelineManager() {}
+
+void PipelineManager::Init() {
+    worker_pool_.Init();
+    task_.Start();
+}
+
+void PipelineManager::Shutdown() {
+    cond_.notify_all();
+    task_.Join();
+    worker_pool_.Shutdown();
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    pipelines_.clear();
+}
+
+std::shared_ptr<LinearPipeline> PipelineManager::Create(
+    const PipelineName& name,
+    std::shared_ptr<VideoSourceFactory> source_factory,
+    std::shared_ptr<VideoTransformerFactory> transformer_factory,
+    TaskUpdatePeriodMs period_ms) {
+    if (Exists(name)) {
+        return nullptr;
+    }
+    auto pipeline = std::make_shared<LinearPipeline>(
+        name, source_factory, transformer_factory, period_ms);
+    return Add(pipeline) ? pipeline : nullptr;
+}
+
+bool PipelineManager::Add(std::shared_ptr<Pipeline> pipeline) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (pipelines_.count(pipeline->Name()) != 0) {
+        spdlog::error("Pipeline {} already exists", pipeline->Name());
+        return false;
+    }
+    pipelines_[pipeline->Name()] = pipeline;
+    spdlog::info("Created pipeline {}", pipeline->Name());
+    return true;
+}
+
+bool PipelineManager::Exists(const PipelineName& name) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (pipelines_.count(name) != 0) {
+        spdlog::error("Pipeline {} already exists", name);
+        return true;
+    }
+    return false;
+}
+
+void PipelineManager::Destroy(const PipelineName& name) {
+    std::shared_ptr<Pipeline> pipeline;
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        auto it = pipelines_.find(name);
+        if (it == pipelines_.end()) {
+            spdlog::error("No pipeline named {}", name);
+            return;
+        }
+        pipeline = it->second;
+        pipelines_.erase(it);
+    }
+    // A frame that is still in flight keeps the pipeline alive until it is
+    // done
+    pipeline->Stop();
+    spdlog::info("Destroyed pipeline {}", name);
+}
+
+std::shared_ptr<Pipeline> PipelineManager::Find(const PipelineName& name) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    auto it = pipelines_.find(name);
+    if (it == pipelines_.end()) {
+        spdlog::error("No pipeline named {}", name);
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::vector<std::shared_ptr<Pipeline>> PipelineManager::List() {
+    std::vector<std::shared_ptr<Pipeline>> pipelines;
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    for (auto& [name, pipeline] : pipelines_) {
+        pipelines.push_back(pipeline);
+    }
+    return pipelines;
+}
+
+void PipelineManager::Start(const PipelineName& name) {
+    auto pipeline = Find(name);
+    if (pipeline) {
+        pipeline->Start();
+        cond_.notify_all();
+    }
+}
+
+void PipelineManager::Stop(const PipelineName& name) {
+    auto pipeline = Find(name);
+    if (pipeline) {
+        pipeline->Stop();
+    }
+}
+
+void PipelineManager::ReportDiagnostics(DiagnosticsReport& report) {
+    worker_pool_.ReportDiagnostics(report);
+    for (auto& pipeline : List()) {
+        pipeline->ReportDiagnostics(report);
+    }
+}
+
+PipelineClock::time_point PipelineManager::DispatchDueFrames() {
+    auto now = PipelineClock::now();
+    auto next_wakeup = now + task_.period_ms_;
+
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    for (auto& [name, pipeline] : pipelines_) {
+        if (!pipeline->IsRunning()) {
+            continue;
+        }
+        if (now >= pipeline->next_frame_time_) {
+            if (pipeline->TryBeginFrame()) {
+                // The frame is captured when it comes due, so its deadline is
+                // measured from the scheduled frame time
+                auto schedule = pipeline->GetSchedule();
+                auto deadline =
+                    pipeline->next_frame_time_ + schedule.latency_budget;
+                pipeline->DispatchFrame(deadline, worker_pool_);
+            } else {
+                pipeline->SkipFrame();
+            }
+            pipeline->next_frame_time_ += pipeline->period_ms_;
+            // Don't try to catch up after a stall; resynchronize instead
+            if (pipeline->next_frame_time_ < now) {
+                pipeline->next_frame_time_ = now + pipeline->period_ms_;
+            }
+        }
+        next_wakeup = std::min(next_wakeup, pipeline->next_frame_time_);
+    }
+    return next_wakeup;
+}
+
+void PipelineManager::TaskFcn(Task* task) {
+    PipelineManager* self = static_cast<PipelineManager*>(task->GetData());
+
+    while (!self->shutting_down_) {
+        auto next_wakeup = self->DispatchDueFrames();
+        std::unique_lock<ProfiledMutex> lock(self->mutex_);
+        self->cond_.wait_until(lock, next_wakeup);
+    }
+}
@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Filename:    source_reader.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "source_reader.h"
+
+#include <utility>
+
+SourceReader::SourceReader(std::shared_ptr<VideoSource> source)
+    : task_(TaskId::SOURCE_READER, TaskPriority::SOURCE_READER,
+            TaskUpdatePeriodMs(0), TaskFcn),
+      source_(std::move(source)),
+      started_(false),
+      stopping_(false) {
+    task_.SetData(this);
+}
+
+SourceReader::~SourceReader() { Stop(); }
+
+void SourceReader::Start() {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (started_ || stopping_) {
+        return;
+    }
+    started_ = true;
+    task_.Start();
+}
+
+void SourceReader::Stop() {
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    // On the reader's own thread this detaches, and the thread's reference
+    // keeps the reader alive until it returns
+    task_.Join();
+}
+
+void SourceReader::Open() {
+    std::lock_guard<ProfiledMutex> lock(source_mutex_);
+    source_->Open();
+}
+
+void SourceReader::Close() {
+    std::lock_guard<ProfiledMutex> lock(source_mutex_);
+    source_->Close();
+}
+
+void SourceReader::SetSource(std::shared_ptr<VideoSource> source) {
+    std::lock_guard<ProfiledMutex> lock(source_mutex_);
+    source_->Close();
+    source_ = std::move(source);
+}
+
+void SourceReader::Request(FrameCallback callback) {
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        if (!stopping_) {
+            request_ = std::move(callback);
+            callback = nullptr;
+        }
+    }
+    if (callback) {
+        // Stopped before the request was made
+        callback(cv::Mat());
+        return;
+    }
+    cond_.notify_one();
+}
+
+void SourceReader::TaskFcn(Task* task) {
+    SourceReader* self = static_cast<SourceReader*>(task->GetData());
+    // A callback may drop the last reference to the pipeline that owns the
+    // reader, which then stops it from this thread
+    auto keepalive = self->shared_from_this();
+
+    while (true) {
+        FrameCallback callback;
+        bool stopping;
+        {
+            std::unique_lock<ProfiledMutex> lock(self->mutex_);
+            self->cond_.wait(lock, [self] {
+                return self->stopping_ || self->request_;
+            });
+            callback = std::move(self->request_);
+            self->request_ = nullptr;
+            stopping = self->stopping_;
+        }
+        if (stopping) {
+            if (callback) {
+                callback(cv::Mat());
+            }
+            break;
+        }
+
+        {
+            std::lock_guard<ProfiledMutex> lock(self->source_mutex_);
+            self->source_->ReadFrame(self->buffer_);
+        }
+        callback(self->buffer_);
+        callback = nullptr;
+    }
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Filename:    edf_scheduler.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "edf_scheduler.h"
+
+#include <algorithm>
+
+namespace {
+// std heaps are max-heaps, so the comparison is reversed to keep the earliest
+// deadline on top
+bool LaterDeadline(const ScheduledWork& a, const ScheduledWork& b) {
+    return a.deadline > b.deadline;
+}
+}  // namespace
+
+void EdfScheduler::Push(ScheduledWork work) {
+    heap_.push_back(std::move(work));
+    std::push_heap(heap_.begin(), heap_.end(), LaterDeadline);
+}
+
+bool EdfScheduler::ShedMostOverdue(SchedulerClock::time_point now,
+                                   std::vector<ScheduledWork>& shed) {
+    auto victim = heap_.end();
+    double victim_score = 0.0;
+    for (auto it = heap_.begin(); it != heap_.end(); ++it) {
+        if (it->priority != StreamPriority::BEST_EFFORT ||
+            it->deadline >= now) {
+            continue;
+        }
+        std::chrono::duration<double> lateness = now - it->deadline;
+        double score = lateness.count() / std::max(it->weight, 1.0e-3);
+        if (victim == heap_.end() || score > victim_score) {
+            victim = it;
+            victim_score = score;
+        }
+    }
+    if (victim == heap_.end()) {
+        return false;
+    }
+
+    shed.push_back(std::move(*victim));
+    *victim = std::move(heap_.back());
+    heap_.pop_back();
+    std::make_heap(heap_.begin(), heap_.end(), LaterDeadline);
+    return true;
+}
+
+bool EdfScheduler::Pop(SchedulerClock::time_point now, ScheduledWork& work,
+                       std::vector<ScheduledWork>& shed) {
+    while (!heap_.empty() && heap_.front().deadline < now) {
+        if (!ShedMostOverdue(now, shed)) {
+            break;
+        }
+    }
+    if (heap_.empty()) {
+        return false;
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), LaterDeadline);
+    work = std::move(heap_.back());
+    heap_.pop_back();
+    return true;
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Filename:    rate_limiter.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "rate_limiter.h"
+
+RateLimiter::RateLimiter(const RateLimit& limit)
+    : limit_(limit), frame_count_(0), frames_run_(0), frames_skipped_(0) {
+    if (limit_.every_n == 0) {
+        limit_.every_n = 1;
+    }
+}
+
+bool RateLimiter::Admit() {
+    bool admit = frame_count_++ % limit_.every_n == 0;
+    if (admit && limit_.min_period.count() > 0) {
+        // A frame that arrives a little early still counts, otherwise e.g.
+        // 15 fps from a 30 fps input would drop to 10 fps on jitter
+        auto now = std::chrono::steady_clock::now();
+        auto tolerance = limit_.min_period / 4;
+        if (now + tolerance < next_time_) {
+            admit = false;
+        } else {
+            next_time_ += limit_.min_period;
+            if (next_time_ <= now) {
+                // The first frame, or the stage fell behind
+                next_time_ = now + limit_.min_period;
+            }
+        }
+    }
+    if (admit) {
+        frames_run_++;
+    } else {
+        frames_skipped_++;
+    }
+    return admit;
+}
+
+void RateLimiter::ReportDiagnostics(const std::string& prefix,
+                                    DiagnosticsReport& report) {
+    report.AddCounter(prefix + " Frames Run", frames_run_);
+    report.AddCounter(prefix + " Frames Skipped", frames_skipped_);
+}
@@ -8,13 +8,124 @@
 #include "task.h"
 
 #include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <ctime>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 #include "logger.h"
+#include "task_scheduling.h"
+#include "trace.h"
+
+namespace {
+
+// Tasks between Start() and Join(), in the order they started
+std::mutex running_tasks_mutex;
+std::vector<Task*> running_tasks;
+
+const char* PolicyName(int policy) {
+    switch (policy) {
+        case SCHED_OTHER:
+            return "SCHED_OTHER";
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+        case SCHED_BATCH:
+            return "SCHED_BATCH";
+        case SCHED_IDLE:
+            return "SCHED_IDLE";
+        case SCHED_DEADLINE:
+            return "SCHED_DEADLINE";
+        default:
+            return "unknown";
+    }
+}
+
+std::string ThreadProcPath(pid_t tid, const char* file) {
+    return "/proc/self/task/" + std::to_string(tid) + "/" + file;
+}
+
+// From the "voluntary_ctxt_switches" and "nonvoluntary_ctxt_switches" lines
+bool ReadContextSwitches(pid_t tid, std::uint64_t& voluntary,
+                         std::uint64_t& involuntary) {
+    std::ifstream status(ThreadProcPath(tid, "status"));
+    std::string line;
+    int found = 0;
+    while (std::getline(status, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "voluntary_ctxt_switches:") {
+            found += static_cast<bool>(fields >> voluntary);
+        } else if (key == "nonvoluntary_ctxt_switches:") {
+            found += static_cast<bool>(fields >> involuntary);
+        }
+    }
+    return found == 2;
+}
+
+// schedstat holds the time spent on the CPU and waiting on a run queue in
+// nanoseconds, then the number of timeslices
+bool ReadRunQueueWait(pid_t tid, double& seconds) {
+    std::ifstream schedstat(ThreadProcPath(tid, "schedstat"));
+    std::uint64_t run_ns = 0;
+    std::uint64_t wait_ns = 0;
+    if (!(schedstat >> run_ns >> wait_ns)) {
+        return false;
+    }
+    seconds = static_cast<double>(wait_ns) * 1.0e-9;
+    return true;
+}
+
+}  // namespace
+
+const char* TaskName(TaskId id) {
+    switch (id) {
+        case TaskId::APP:
+            return "app";
+        case TaskId::VIDEO_INPUT:
+            return "video_input";
+        case TaskId::VIDEO_PROCESSING:
+            return "video_processing";
+        case TaskId::VIDEO_OUTPUT:
+            return "video_output";
+        case TaskId::VIDEO_PLAYER:
+            return "video_player";
+        case TaskId::VIDEO_RECORDER:
+            return "video_recorder";
+        case TaskId::PIPELINE_MANAGER:
+            return "pipeline_manager";
+        case TaskId::WORKER:
+            return "worker";
+        case TaskId::SOURCE_READER:
+            return "source_reader";
+        case TaskId::MJPEG_ENCODER:
+            return "mjpeg_encoder";
+        case TaskId::MJPEG_SERVER:
+            return "mjpeg_server";
+        case TaskId::METRICS_EXPORTER:
+            return "metrics_exporter";
+        case TaskId::FLIGHT_RECORDER:
+            return "flight_recorder";
+#ifdef DIAGNOSTICS_ENABLED
+        case TaskId::DIAGNOSTICS:
+            return "diagnostics";
+#endif
+        default:
+            return "unknown";
+    }
+}
 
 Task::Task(TaskId id, TaskPriority priority, TaskUpdatePeriodMs period_ms,
            TaskFunction function)
@@ -22,21 +133,100 @@ Task::Task(TaskId id, TaskPriority priority, TaskUpdatePeriodMs period_ms,
       priority_(priority),
       period_ms_(period_ms),
       function_(function),
-      data_(nullptr) {}
+      data_(nullptr),
+      tid_(0) {}
 
 void Task::Start() {
-    thread_ = std::thread(function_, this);
-    sched_param sch_params;
-    sch_params.sched_priority = static_cast<int>(priority_);
-    if (pthread_setschedparam(thread_.native_handle(), SCHED_FIFO,
-                              &sch_params) != 0) {
-        spdlog::error("Failed to set thread priority: {}", strerror(errno));
+    tid_ = 0;
+    start_time_ = std::chrono::steady_clock::now();
+    auto profile = GetTaskSchedulingProfile(id_, priority_);
+    thread_ = std::thread([this, profile] {
+        tid_ = static_cast<pid_t>(syscall(SYS_gettid));
+        // Before the task's work, so none of it runs on the wrong CPU
+        ApplyTaskSchedulingProfile(TaskName(id_), profile);
+        Tracer::instance().SetThreadName(TaskName(id_));
+        function_(this);
+    });
+    std::lock_guard<std::mutex> lock(running_tasks_mutex);
+    if (std::find(running_tasks.begin(), running_tasks.end(), this) ==
+        running_tasks.end()) {
+        running_tasks.push_back(this);
     }
 }
 
 void Task::Join() {
-    if (thread_.joinable()) {
-        thread_.join();
+    {
+        // Reports use the thread handle, so stop them before it goes away
+        std::lock_guard<std::mutex> lock(running_tasks_mutex);
+        running_tasks.erase(
+            std::remove(running_tasks.begin(), running_tasks.end(), this),
+            running_tasks.end());
+    }
+    if (!thread_.joinable()) {
+        return;
+    }
+    // A task that ends itself can't wait for itself; it is already finishing
+    if (thread_.get_id() == std::this_thread::get_id()) {
+        thread_.detach();
+        return;
+    }
+    thread_.join();
+}
+
+void Task::ReportDiagnostics(DiagnosticsReport& report) {
+    std::lock_guard<std::mutex> lock(running_tasks_mutex);
+    // Tasks that share an id, like the workers, are numbered from the second
+    std::map<TaskId, int> instances;
+    for (auto* task : running_tasks) {
+        auto instance = ++instances[task->id_];
+        auto prefix = std::string("Task ") + TaskName(task->id_);
+        if (instance > 1) {
+            prefix += " " + std::to_string(instance);
+        }
+        task->ReportThreadDiagnostics(prefix, report);
+    }
+}
+
+void Task::ReportThreadDiagnostics(const std::string& prefix,
+                                   DiagnosticsReport& report) {
+    auto tid = tid_.load();
+    if (tid == 0) {
+        return;
+    }
+    std::chrono::duration<double> running =
+        std::chrono::steady_clock::now() - start_time_;
+    report.AddValue(prefix + " Running Seconds", running.count());
+
+    // The other thread's CLOCK_THREAD_CPUTIME_ID
+    clockid_t clock;
+    timespec cpu_time;
+    if (pthread_getcpuclockid(thread_.native_handle(), &clock) == 0 &&
+        clock_gettime(clock, &cpu_time) == 0) {
+        double cpu_seconds = cpu_time.tv_sec + cpu_time.tv_nsec * 1.0e-9;
+        report.AddValue(prefix + " CPU Seconds", cpu_seconds);
+    }
+
+    std::uint64_t voluntary = 0;
+    std::uint64_t involuntary = 0;
+    if (ReadContextSwitches(tid, voluntary, involuntary)) {
+        report.AddCounter(prefix + " Voluntary Context Switches", voluntary);
+        report.AddCounter(prefix + " Involuntary Context Switches",
+                          involuntary);
+    }
+
+    // Time spent runnable but not running: a starved task waits here
+    double wait_seconds = 0.0;
+    if (ReadRunQueueWait(tid, wait_seconds)) {
+        report.AddValue(prefix + " Run Queue Wait Seconds", wait_seconds);
+    }
+
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(thread_.native_handle(), &policy, &param) ==
+        0) {
+        // Set to 1 under the policy's name, which a number wouldn't show
+        report.AddValue(prefix + " Policy " + PolicyName(policy), 1.0);
+        report.AddValue(prefix + " Priority", param.sched_priority);
     }
 }
 
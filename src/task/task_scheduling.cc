@@ -0,0 +1,324 @@
+/******************************************************************************
+ * Filename:    task_scheduling.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "task_scheduling.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include "error_handling.h"
+#include "logger.h"
+
+namespace {
+
+std::mutex profiles_mutex;
+TaskSchedulingProfiles task_profiles;
+
+// Not declared by every libc
+struct SchedAttr {
+    std::uint32_t size;
+    std::uint32_t sched_policy;
+    std::uint64_t sched_flags;
+    std::int32_t sched_nice;
+    std::uint32_t sched_priority;
+    std::uint64_t sched_runtime;
+    std::uint64_t sched_deadline;
+    std::uint64_t sched_period;
+};
+constexpr std::uint64_t kSchedFlagResetOnFork = 0x01;
+
+std::string ConfigError(const std::string& filename, int line,
+                        const std::string& message) {
+    return filename + ":" + std::to_string(line) + ": " + message;
+}
+
+bool ParseInt(const std::string& text, int& value) {
+    auto end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// e.g. 2,4-7
+bool ParseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::stringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        auto dash = range.find('-');
+        int first;
+        int last;
+        if (dash == std::string::npos) {
+            if (!ParseInt(range, first)) {
+                return false;
+            }
+            last = first;
+        } else if (!ParseInt(range.substr(0, dash), first) ||
+                   !ParseInt(range.substr(dash + 1), last)) {
+            return false;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+bool ParsePolicy(const std::string& text, SchedulingPolicy& policy) {
+    if (text == "other") {
+        policy = SchedulingPolicy::OTHER;
+    } else if (text == "fifo") {
+        policy = SchedulingPolicy::FIFO;
+    } else if (text == "rr") {
+        policy = SchedulingPolicy::RR;
+    } else if (text == "deadline") {
+        policy = SchedulingPolicy::DEADLINE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool FindTaskId(const std::string& name, TaskId& id) {
+    for (int i = 0; i < static_cast<int>(TaskId::COUNT); i++) {
+        if (name == TaskName(static_cast<TaskId>(i))) {
+            id = static_cast<TaskId>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SetAffinity(const char* task_name, const std::vector<int>& cpus) {
+    // The cpuset of a shared box may not give us every CPU asked for
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            CPU_SET(cpu, &set);
+        } else {
+            spdlog::warn("{} can't run on CPU {}, it isn't available",
+                         task_name, cpu);
+        }
+    }
+    if (CPU_COUNT(&set) == 0) {
+        spdlog::warn("{} runs on any CPU, none of its CPUs are available",
+                     task_name);
+        return;
+    }
+    // 0 is the calling thread
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        spdlog::warn("Failed to pin {} to its CPUs: {}", task_name,
+                     strerror(errno));
+    }
+}
+
+bool SetPolicy(const char* task_name, int policy, int priority) {
+    auto min = sched_get_priority_min(policy);
+    auto max = sched_get_priority_max(policy);
+    sched_param param;
+    param.sched_priority = std::min(std::max(priority, min), max);
+    // Returns the error rather than setting errno
+    int error = pthread_setschedparam(pthread_self(), policy, &param);
+    if (error != 0) {
+        spdlog::warn("{} falls back to SCHED_OTHER: {}", task_name,
+                     strerror(error));
+        return false;
+    }
+    return true;
+}
+
+bool SetDeadline(const char* task_name, const TaskSchedulingProfile& profile) {
+    auto deadline = profile.deadline.count() > 0 ? profile.deadline
+                                                 : profile.period;
+    SchedAttr attr{};
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    // A deadline task can't fork or clone unless its children start out of
+    // SCHED_DEADLINE, e.g. OpenCV starting its worker threads
+    attr.sched_flags = kSchedFlagResetOnFork;
+    attr.sched_runtime = std::chrono::nanoseconds(profile.runtime).count();
+    attr.sched_deadline = std::chrono::nanoseconds(deadline).count();
+    attr.sched_period = std::chrono::nanoseconds(profile.period).count();
+    // Admission control refuses what doesn't fit the CPUs' bandwidth
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0) {
+        spdlog::warn("{} falls back to SCHED_OTHER, SCHED_DEADLINE failed: {}",
+                     task_name, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void SetNice(const char* task_name, int nice) {
+    // Threads inherit their creator's policy, which may be real-time
+    SetPolicy(task_name, SCHED_OTHER, 0);
+    if (nice == 0) {
+        return;
+    }
+    // On Linux a thread id sets the nice value of just that thread
+    auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, nice) != 0) {
+        spdlog::warn("{} keeps the default nice value, nice {} failed: {}",
+                     task_name, nice, strerror(errno));
+    }
+}
+
+}  // namespace
+
+TaskSchedulingProfiles LoadTaskSchedulingConfig(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw SchedulingConfigException("Failed to open scheduling config: " +
+                                        filename);
+    }
+
+    TaskSchedulingProfiles profiles;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        auto comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::vector<std::string> tokens;
+        std::istringstream stream(line);
+        std::string token;
+        while (stream >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        auto error = [&](const std::string& message) {
+            return SchedulingConfigException(
+                ConfigError(filename, line_number, message));
+        };
+        TaskId id;
+        if (!FindTaskId(tokens[0], id)) {
+            throw error("unknown task: " + tokens[0]);
+        }
+        if (profiles.count(id) != 0) {
+            throw error("duplicate task: " + tokens[0]);
+        }
+
+        TaskSchedulingProfile profile;
+        for (std::size_t i = 1; i < tokens.size(); i++) {
+            auto equals = tokens[i].find('=');
+            if (equals == std::string::npos) {
+                throw error("expected key=value: " + tokens[i]);
+            }
+            auto key = tokens[i].substr(0, equals);
+            auto value = tokens[i].substr(equals + 1);
+            int number = 0;
+            bool valid;
+            if (key == "cpus") {
+                valid = ParseCpuList(value, profile.cpus);
+            } else if (key == "policy") {
+                valid = ParsePolicy(value, profile.policy);
+            } else if (key == "priority") {
+                valid = ParseInt(value, profile.priority) &&
+                        profile.priority >= 1 && profile.priority <= 99;
+            } else if (key == "nice") {
+                valid = ParseInt(value, profile.nice) && profile.nice >= -20 &&
+                        profile.nice <= 19;
+            } else if (key == "runtime_us" || key == "deadline_us" ||
+                       key == "period_us") {
+                valid = ParseInt(value, number) && number > 0;
+                auto& field = key == "runtime_us"    ? profile.runtime
+                              : key == "deadline_us" ? profile.deadline
+                                                     : profile.period;
+                field = std::chrono::microseconds(number);
+            } else {
+                throw error("unknown key: " + key);
+            }
+            if (!valid) {
+                throw error("invalid " + key + ": " + value);
+            }
+        }
+
+        if (profile.policy == SchedulingPolicy::DEADLINE) {
+            auto deadline = profile.deadline.count() > 0 ? profile.deadline
+                                                         : profile.period;
+            if (profile.runtime.count() == 0 || profile.period.count() == 0) {
+                throw error("deadline needs runtime_us and period_us");
+            }
+            if (profile.runtime > deadline || deadline > profile.period) {
+                throw error("deadline needs runtime <= deadline <= period");
+            }
+            // The kernel won't let a deadline task be pinned to fewer CPUs
+            // than its root domain; isolate CPUs with cpusets instead
+            if (!profile.cpus.empty()) {
+                throw error("cpus can't be set for a deadline task");
+            }
+        }
+        profiles[id] = profile;
+    }
+    return profiles;
+}
+
+void SetTaskSchedulingProfiles(const TaskSchedulingProfiles& profiles) {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    task_profiles = profiles;
+}
+
+TaskSchedulingProfile GetTaskSchedulingProfile(TaskId id,
+                                               TaskPriority priority) {
+    TaskSchedulingProfile profile;
+    {
+        std::lock_guard<std::mutex> lock(profiles_mutex);
+        auto it = task_profiles.find(id);
+        if (it != task_profiles.end()) {
+            profile = it->second;
+        }
+    }
+    if (profile.priority == 0) {
+        profile.priority = static_cast<int>(priority);
+    }
+    return profile;
+}
+
+void ApplyTaskSchedulingProfile(const char* task_name,
+                                const TaskSchedulingProfile& profile) {
+    bool realtime = false;
+    switch (profile.policy) {
+        case SchedulingPolicy::FIFO:
+            realtime = SetPolicy(task_name, SCHED_FIFO, profile.priority);
+            break;
+        case SchedulingPolicy::RR:
+            realtime = SetPolicy(task_name, SCHED_RR, profile.priority);
+            break;
+        case SchedulingPolicy::DEADLINE:
+            realtime = SetDeadline(task_name, profile);
+            break;
+        case SchedulingPolicy::OTHER:
+            break;
+    }
+    if (!realtime) {
+        SetNice(task_name, profile.nice);
+    }
+    if (!profile.cpus.empty()) {
+        SetAffinity(task_name, profile.cpus);
+    }
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Filename:    worker_pool.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "worker_pool.h"
+
+#include <algorithm>
+
+#include "logger.h"
+
+WorkerPool::WorkerPool(TaskPriority priority, std::size_t worker_count)
+    : work_dispatched_(0), work_shed_(0), stopping_(false) {
+    worker_count = std::max<std::size_t>(worker_count, 1);
+    for (std::size_t i = 0; i < worker_count; i++) {
+        auto worker = std::make_unique<Task>(TaskId::WORKER, priority,
+                                             TaskUpdatePeriodMs(0), TaskFcn);
+        worker->SetData(this);
+        workers_.push_back(std::move(worker));
+    }
+}
+
+WorkerPool::~WorkerPool() { Shutdown(); }
+
+void WorkerPool::Init() {
+    for (auto& worker : workers_) {
+        worker->Start();
+    }
+}
+
+void WorkerPool::Shutdown() {
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        stopping_ = true;
+        scheduler_.Clear();
+    }
+    cond_.notify_all();
+    for (auto& worker : workers_) {
+        worker->Join();
+    }
+}
+
+void WorkerPool::Submit(WorkItem item) {
+    ScheduledWork work;
+    work.run = std::move(item);
+    work.deadline = SchedulerClock::now();
+    Submit(std::move(work));
+}
+
+void WorkerPool::Submit(ScheduledWork work) {
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        scheduler_.Push(std::move(work));
+    }
+    cond_.notify_one();
+}
+
+std::size_t WorkerPool::QueueDepth() {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    return scheduler_.Size();
+}
+
+void WorkerPool::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddCounter("Worker Pool Threads", WorkerCount());
+    report.AddCounter("Worker Pool Queue Depth", QueueDepth());
+    report.AddCounter("Worker Pool Work Dispatched", work_dispatched_);
+    report.AddCounter("Worker Pool Work Shed", work_shed_);
+}
+
+void WorkerPool::TaskFcn(Task* task) {
+    WorkerPool* self = static_cast<WorkerPool*>(task->GetData());
+
+    std::vector<ScheduledWork> shed;
+    while (true) {
+        ScheduledWork work;
+        bool have_work = false;
+        {
+            std::unique_lock<ProfiledMutex> lock(self->mutex_);
+            self->cond_.wait(lock, [self] {
+                return self->stopping_ || !self->scheduler_.Empty();
+            });
+            if (self->stopping_) {
+                break;
+            }
+            have_work =
+                self->scheduler_.Pop(SchedulerClock::now(), work, shed);
+        }
+
+        // Shed work still has to be released by its owner
+        for (auto& shed_work : shed) {
+            self->work_shed_++;
+            if (shed_work.shed) {
+                shed_work.shed();
+            }
+        }
+        shed.clear();
+
+        if (have_work) {
+            self->work_dispatched_++;
+            try {
+                work.run();
+            } catch (const std::exception& e) {
+                spdlog::error("Work item failed: {}", e.what());
+            }
+        }
+    }
+}
@@ -1,8 +1,9 @@
 /******************************************************************************
  * Filename:    diagnostics.cpp
  * Description: Diagnostics task implementation. This file defines the behavior
- *              of the diagnostics task, responsible for generating diagnostics
- *              information and writing it to a file at regular intervals.
+ *              of the diagnostics task, responsible for reporting the
+ *              application's statistics to the metrics registry and
+ *              optionally writing them to a file at regular intervals.
  * Copyright (c) 2023 Keaton Scheible
  *****************************************************************************/
 
@@ -17,7 +18,9 @@
 #include <mutex>
 
 #include "error_handling.h"
+#include "flight_recorder.h"
 #include "logger.h"
+#include "pipeline_manager.h"
 #include "video_input.h"
 #include "video_output.h"
 #include "video_processor.h"
@@ -28,23 +31,52 @@ Diagnostics::Diagnostics(TaskId id, TaskPriority priority,
                          TaskUpdatePeriodMs period_ms, VideoInput& video_input,
                          VideoProcessor& video_processor,
                          VideoOutput& video_output,
+                         PipelineManager& pipeline_manager,
                          std::atomic<bool>& shutting_down)
     : task_(id, priority, period_ms, TaskFcn),
       video_input_(video_input),
       video_processor_(video_processor),
       video_output_(video_output),
+      pipeline_manager_(pipeline_manager),
+      file_output_(false),
       shutting_down_(shutting_down) {
     task_.SetData(this);
-    CreateDiagnosticsFolder();
-    OpenDiagnosticsFile();
+    collector_id_ = MetricsRegistry::instance().AddCollector(
+        [this](DiagnosticsReport& report) { CollectReport(report); });
 }
 
 Diagnostics::~Diagnostics() {
-    CloseDiagnosticsFile();
-    RemoveDiagnosticsFolder();
+    MetricsRegistry::instance().RemoveCollector(collector_id_);
+    try {
+        SetFileOutput(false);
+    } catch (const DiagnosticsException& e) {
+        spdlog::error("{}", e.what());
+    }
     spdlog::info("Shutting down diagnostics");
 }
 
+bool Diagnostics::SetFileOutput(bool enabled) {
+    std::lock_guard<ProfiledMutex> lock(file_mutex_);
+    if (enabled == file_output_) {
+        return true;
+    }
+    if (enabled) {
+        try {
+            CreateDiagnosticsFolder();
+            OpenDiagnosticsFile();
+        } catch (const DiagnosticsException& e) {
+            spdlog::error("{}", e.what());
+            return false;
+        }
+        spdlog::info("Writing diagnostics to {}", kDiagonsticsFile);
+    } else {
+        CloseDiagnosticsFile();
+        RemoveDiagnosticsFolder();
+    }
+    file_output_ = enabled;
+    return true;
+}
+
 void Diagnostics::CreateDiagnosticsFolder() {
     if (!fs::exists(kDiagonsticsFolder)) {
         if (!fs::create_directory(kDiagonsticsFolder)) {
@@ -81,36 +113,42 @@ void Diagnostics::RemoveDiagnosticsFolder() {
 void Diagnostics::ResetDiagnosticsLog() { diagnostics_log_.seekp(0); }
 
 void Diagnostics::UpdateDiagnosticsLog() {
+    std::lock_guard<ProfiledMutex> lock(file_mutex_);
+    if (!file_output_) {
+        return;
+    }
+    auto snapshot = MetricsRegistry::instance().Snapshot();
     ResetDiagnosticsLog();
-    UpdateStatistics();
-    constexpr int kPrecision = 2;
-    diagnostics_log_
-        << "                   Average     Minimum     Maximum     "
-           "Variance    Standard Deviation     \n";
-    diagnostics_log_ << "Processing Time:   ";
-    diagnostics_log_ << std::scientific << std::setprecision(kPrecision)
-                     << video_processing_time_stats_.average << "    ";
-    diagnostics_log_ << std::scientific << std::setprecision(kPrecision)
-                     << video_processing_time_stats_.minimum << "    ";
-    diagnostics_log_ << std::scientific << std::setprecision(kPrecision)
-                     << video_processing_time_stats_.maximum << "    ";
-    diagnostics_log_ << std::scientific << std::setprecision(kPrecision)
-                     << video_processing_time_stats_.variance << "    ";
-    diagnostics_log_ << std::scientific << std::setprecision(kPrecision)
-                     << video_processing_time_stats_.standard_deviation
-                     << "    ";
-    diagnostics_log_ << "\n";
+    WriteMetricsText(snapshot, diagnostics_log_);
+    // The log is rewritten in place, so blank out whatever a previous,
+    // longer report left behind
+    diagnostics_log_ << std::string(kDiagnosticsPadding, ' ') << std::flush;
 }
 
-void Diagnostics::UpdateStatistics() {
-    video_processing_time_stats_ = video_processor_.time_stats_.GetStatistics();
+void Diagnostics::CollectReport(DiagnosticsReport& report) {
+    report.AddTimeStatistics("Processing Time",
+                             video_processor_.time_stats_.GetStatistics());
+    report.AddTimeStatistics("Output Time",
+                             video_output_.time_stats_.GetStatistics());
+    video_processor_.ReportDiagnostics(report);
+    video_input_.ReportFrameDiagnostics("Input", report);
+    video_processor_.ReportFrameDiagnostics("Processing", report);
+    video_output_.ReportDiagnostics(report);
+    video_input_.ReportPerfDiagnostics("Input", report);
+    video_processor_.ReportPerfDiagnostics("Processing", report);
+    video_output_.ReportPerfDiagnostics("Output", report);
+    pipeline_manager_.ReportDiagnostics(report);
+    Task::ReportDiagnostics(report);
+    LockProfiler::instance().ReportDiagnostics(report);
+    report.AddCounter("Flight Recorder Dumps",
+                      FlightRecorder::instance().Dumps());
 }
 
 void Diagnostics::TaskFcn(Task* task) {
     Diagnostics* self = static_cast<Diagnostics*>(task->GetData());
 
     while (!self->shutting_down_) {
-        std::unique_lock<std::mutex> lock(self->mutex);
+        std::unique_lock<ProfiledMutex> lock(self->mutex);
         self->cond.wait_for(lock, task->period_ms_);
         self->UpdateDiagnosticsLog();
     }
@@ -0,0 +1,249 @@
+/******************************************************************************
+ * Filename:    flight_recorder.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "logger.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::uint64_t SteadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// e.g. 20230614_153012_045, so dumps sort by time
+std::string FileTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto time = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  now.time_since_epoch())
+                  .count() %
+              1000;
+    std::tm local{};
+    localtime_r(&time, &local);
+    std::ostringstream text;
+    text << std::put_time(&local, "%Y%m%d_%H%M%S") << "_" << std::setw(3)
+         << std::setfill('0') << ms;
+    return text.str();
+}
+
+}  // namespace
+
+FlightRecorder& FlightRecorder::instance() {
+    static FlightRecorder recorder;
+    return recorder;
+}
+
+FlightRecorder::FlightRecorder()
+    : slots_(kCapacity),
+      next_(0),
+      running_(false),
+      frame_deadline_ms_(FlightRecorderConfig().frame_deadline.count()),
+      margin_ns_(std::chrono::nanoseconds(FlightRecorderConfig().margin)
+                     .count()),
+      dump_requested_(false),
+      dumps_(0),
+      task_(TaskId::FLIGHT_RECORDER, TaskPriority::FLIGHT_RECORDER,
+            TaskUpdatePeriodMs(100), TaskFcn) {
+    task_.SetData(this);
+}
+
+FlightRecorder::~FlightRecorder() { Stop(); }
+
+void FlightRecorder::Start(const FlightRecorderConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+    }
+    frame_deadline_ms_ = config.frame_deadline.count();
+    margin_ns_ = std::chrono::nanoseconds(config.margin).count();
+    if (!running_.exchange(true)) {
+        task_.Start();
+    }
+}
+
+void FlightRecorder::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    cond_.notify_all();
+    task_.Join();
+}
+
+FlightRecorderConfig FlightRecorder::Config() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+}
+
+void FlightRecorder::Record(const char* source, const char* kind,
+                            std::uint64_t frame, double value,
+                            std::string_view text) {
+    auto index = next_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[index & (kCapacity - 1)];
+    auto sequence = 2 * index + 1;
+    slot.sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.time_ns.store(SteadyNowNs(), std::memory_order_relaxed);
+    slot.source.store(source, std::memory_order_relaxed);
+    slot.kind.store(kind, std::memory_order_relaxed);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    slot.value.store(value, std::memory_order_relaxed);
+    char buffer[kTextSize] = {};
+    std::memcpy(buffer, text.data(), std::min(text.size(), kTextSize - 1));
+    for (std::size_t i = 0; i < slot.text.size(); i++) {
+        std::uint64_t word;
+        std::memcpy(&word, buffer + i * sizeof(word), sizeof(word));
+        slot.text[i].store(word, std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+void FlightRecorder::CheckLateness(const char* source, std::uint64_t frame,
+                                   double lateness, std::string_view text) {
+    if (lateness <= 0.0) {
+        return;
+    }
+    Record(source, "late", frame, lateness, text);
+    if (lateness * 1.0e9 <= margin_ns_.load(std::memory_order_relaxed) ||
+        !running_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // The dump itself happens on the recorder task; the first request wakes
+    // it and later ones until the dump are folded into it
+    if (!dump_requested_.exchange(true)) {
+        cond_.notify_one();
+    }
+}
+
+void FlightRecorder::RequestDump(const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dump_reason_ = reason;
+        // Asked for explicitly, so it isn't held back by the interval
+        last_dump_time_ = std::chrono::steady_clock::time_point();
+    }
+    dump_requested_ = true;
+    cond_.notify_one();
+}
+
+std::vector<FlightEvent> FlightRecorder::Snapshot() const {
+    std::vector<FlightEvent> events;
+    events.reserve(kCapacity);
+    for (auto& slot : slots_) {
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || (sequence & 1)) {
+            continue;
+        }
+        FlightEvent event;
+        event.time_ns = slot.time_ns.load(std::memory_order_relaxed);
+        event.source = slot.source.load(std::memory_order_relaxed);
+        event.kind = slot.kind.load(std::memory_order_relaxed);
+        event.frame = slot.frame.load(std::memory_order_relaxed);
+        event.value = slot.value.load(std::memory_order_relaxed);
+        char buffer[kTextSize];
+        for (std::size_t i = 0; i < slot.text.size(); i++) {
+            auto word = slot.text[i].load(std::memory_order_relaxed);
+            std::memcpy(buffer + i * sizeof(word), &word, sizeof(word));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Rewritten while it was copied
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        buffer[kTextSize - 1] = '\0';
+        event.text = buffer;
+        events.push_back(std::move(event));
+    }
+    std::sort(events.begin(), events.end(),
+              [](const FlightEvent& a, const FlightEvent& b) {
+                  return a.time_ns < b.time_ns;
+              });
+    return events;
+}
+
+void FlightRecorder::TaskFcn(Task* task) {
+    FlightRecorder* self = static_cast<FlightRecorder*>(task->GetData());
+
+    while (self->running_) {
+        std::string reason;
+        {
+            std::unique_lock<std::mutex> lock(self->mutex_);
+            // The timeout covers a request that raced with going to sleep
+            self->cond_.wait_for(lock, task->period_ms_, [self] {
+                return !self->running_ || self->dump_requested_;
+            });
+            if (!self->dump_requested_) {
+                continue;
+            }
+            // Misses soon after a dump wait out the interval, then share
+            // one dump that also holds what led up to them
+            auto dump_allowed = [self] {
+                return !self->running_ ||
+                       std::chrono::steady_clock::now() >=
+                           self->last_dump_time_ +
+                               self->config_.min_dump_interval;
+            };
+            self->cond_.wait_until(
+                lock, self->last_dump_time_ + self->config_.min_dump_interval,
+                dump_allowed);
+            if (!self->running_) {
+                break;
+            }
+            reason = self->dump_reason_.empty() ? "deadline miss"
+                                                : self->dump_reason_;
+            self->dump_reason_.clear();
+            self->dump_requested_ = false;
+            self->last_dump_time_ = std::chrono::steady_clock::now();
+        }
+        self->WriteDump(reason);
+    }
+}
+
+void FlightRecorder::WriteDump(const std::string& reason) {
+    auto events = Snapshot();
+    auto now_ns = SteadyNowNs();
+    auto folder = Config().folder;
+    auto filename = folder + "/flight_" + FileTimestamp() + ".txt";
+
+    std::error_code error;
+    fs::create_directories(folder, error);
+    std::ofstream out(filename);
+    if (!out) {
+        spdlog::error("Failed to write flight recorder dump {}", filename);
+        return;
+    }
+    out << "# Flight recorder dump: " << reason << "\n";
+    out << "# time_ms source kind frame value text\n";
+    out << std::fixed;
+    for (auto& event : events) {
+        auto age_ms = (static_cast<double>(event.time_ns) -
+                       static_cast<double>(now_ns)) *
+                      1.0e-6;
+        out << std::setprecision(3) << age_ms << " " << event.source << " "
+            << event.kind << " " << event.frame << " " << std::setprecision(6)
+            << event.value;
+        if (!event.text.empty()) {
+            out << " " << event.text;
+        }
+        out << "\n";
+    }
+    dumps_++;
+    spdlog::warn("Flight recorder: {}, wrote {} events to {}", reason,
+                 events.size(), filename);
+}
@@ -5,8 +5,31 @@
 
 #include "logger.h"
 
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
+#include <string_view>
+
+#include "flight_recorder.h"
+
+namespace {
+
+// Keeps warnings and errors in the flight recorder, so a dump shows what was
+// logged around a missed deadline. The recorder is thread safe on its own.
+class FlightRecorderSink
+    : public spdlog::sinks::base_sink<spdlog::details::null_mutex> {
+   protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        FlightRecorder::instance().Record(
+            "log", msg.level >= spdlog::level::err ? "error" : "warning", 0,
+            0.0, std::string_view(msg.payload.data(), msg.payload.size()));
+    }
+    void flush_() override {}
+};
+
+}  // namespace
+
 Logger::Logger() {
     auto console = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
     console->set_pattern("%^%v%$");
@@ -17,7 +40,11 @@ Logger::Logger() {
     console->set_color(spdlog::level::debug, console->blue);
     console->set_color(spdlog::level::trace, console->magenta);
 
-    logger_ = std::make_shared<spdlog::logger>("console", console);
+    auto recorder = std::make_shared<FlightRecorderSink>();
+    recorder->set_level(spdlog::level::warn);
+
+    logger_ = std::make_shared<spdlog::logger>(
+        "console", spdlog::sinks_init_list{console, recorder});
     logger_->set_level(spdlog::level::trace);
     spdlog::set_default_logger(logger_);
 }
@@ -0,0 +1,328 @@
+/******************************************************************************
+ * Filename:    metrics.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#include "logger.h"
+
+namespace {
+
+void WriteTimeStatistics(std::ostream& out, const std::string& name,
+                         const Statistics<double>& statistics) {
+    constexpr int kPrecision = 2;
+    constexpr int kNameWidth = 19;
+    out << std::left << std::setw(kNameWidth) << (name + ":") << std::right
+        << std::scientific << std::setprecision(kPrecision);
+    out << statistics.average << "    " << statistics.minimum << "    "
+        << statistics.maximum << "    " << statistics.variance << "    "
+        << statistics.standard_deviation << "    \n";
+    out << std::defaultfloat;
+}
+
+// Lower case with runs of anything but letters and digits collapsed to one
+// underscore, e.g. "Pipeline cam0 Copy-On-Write Copies" becomes
+// pipeline_cam0_copy_on_write_copies
+std::string MetricName(const std::string& prefix, const std::string& name) {
+    std::string result = prefix;
+    bool separator = false;
+    for (unsigned char c : name) {
+        if (std::isalnum(c)) {
+            if (separator && result.size() > prefix.size()) {
+                result += '_';
+            }
+            result += static_cast<char>(std::tolower(c));
+            separator = false;
+        } else {
+            separator = true;
+        }
+    }
+    return result;
+}
+
+std::string FormatValue(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    // The shortest form that reads back exactly, so bounds print as 0.1
+    // rather than 0.10000000000000001
+    std::string text;
+    for (int precision = std::numeric_limits<double>::digits10;
+         precision <= std::numeric_limits<double>::max_digits10; precision++) {
+        std::ostringstream stream;
+        stream << std::setprecision(precision) << value;
+        text = stream.str();
+        if (std::stod(text) == value) {
+            break;
+        }
+    }
+    return text;
+}
+
+std::mutex collisions_mutex;
+std::set<std::string> collisions;
+
+// Collectors report whatever names their components use, so two of them can
+// map to the same metric; only the first is exported. The rest are logged
+// once, as every scrape would find them again.
+bool WriteFamily(std::set<std::string>& written, std::ostream& out,
+                 const std::string& name, const std::string& source,
+                 const char* type) {
+    if (!written.insert(name).second) {
+        std::lock_guard<std::mutex> lock(collisions_mutex);
+        if (collisions.insert(source).second) {
+            spdlog::warn("\"{}\" isn't exported, its metric name {} is taken",
+                         source, name);
+        }
+        return false;
+    }
+    out << "# TYPE " << name << " " << type << "\n";
+    return true;
+}
+
+}  // namespace
+
+std::size_t MetricShard() {
+    static std::atomic<std::size_t> next_shard(0);
+    thread_local std::size_t shard = next_shard++ % kMetricShards;
+    return shard;
+}
+
+std::uint64_t Counter::Value() const {
+    std::uint64_t value = 0;
+    for (auto& shard : shards_) {
+        value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+double HistogramSample::Quantile(double q) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    auto rank = static_cast<std::uint64_t>(std::ceil(q * count));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bounds.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bounds[i];
+        }
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    for (auto& shard : shards_) {
+        shard.counts = std::make_unique<std::atomic<std::uint64_t>[]>(
+            bounds_.size() + 1);
+        for (std::size_t i = 0; i <= bounds_.size(); i++) {
+            shard.counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Histogram::Observe(double seconds) {
+    // Bucket lists are short, so a linear scan beats a binary search
+    std::size_t bucket = 0;
+    while (bucket < bounds_.size() && seconds > bounds_[bucket]) {
+        bucket++;
+    }
+    auto& shard = shards_[MetricShard()];
+    shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_ns.fetch_add(
+        static_cast<std::uint64_t>(std::max(0.0, seconds) * 1.0e9),
+        std::memory_order_relaxed);
+}
+
+HistogramSample Histogram::Sample() const {
+    HistogramSample sample;
+    sample.bounds = bounds_;
+    sample.counts.assign(bounds_.size() + 1, 0);
+    std::uint64_t sum_ns = 0;
+    for (auto& shard : shards_) {
+        for (std::size_t i = 0; i <= bounds_.size(); i++) {
+            sample.counts[i] +=
+                shard.counts[i].load(std::memory_order_relaxed);
+        }
+        sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    }
+    // The count is derived from the buckets, so the two always agree
+    for (auto count : sample.counts) {
+        sample.count += count;
+    }
+    sample.sum = static_cast<double>(sum_ns) * 1.0e-9;
+    return sample;
+}
+
+std::vector<double> DefaultLatencyBuckets() {
+    return {1.0e-4, 2.5e-4, 5.0e-4, 1.0e-3, 2.5e-3, 5.0e-3, 1.0e-2,
+            2.5e-2, 5.0e-2, 1.0e-1, 2.5e-1, 5.0e-1, 1.0};
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<Counter> MetricsRegistry::GetCounter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& counter = counters_[name];
+    if (!counter) {
+        counter = std::make_shared<Counter>();
+    }
+    return counter;
+}
+
+std::shared_ptr<Gauge> MetricsRegistry::GetGauge(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& gauge = gauges_[name];
+    if (!gauge) {
+        gauge = std::make_shared<Gauge>();
+    }
+    return gauge;
+}
+
+std::shared_ptr<Histogram> MetricsRegistry::GetHistogram(
+    const std::string& name, std::vector<double> bounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& histogram = histograms_[name];
+    if (!histogram) {
+        histogram = std::make_shared<Histogram>(std::move(bounds));
+    }
+    return histogram;
+}
+
+MetricsRegistry::CollectorId MetricsRegistry::AddCollector(
+    Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto id = next_collector_id_++;
+    collectors_[id] = std::move(collector);
+    return id;
+}
+
+void MetricsRegistry::RemoveCollector(CollectorId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.erase(id);
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() {
+    MetricsSnapshot snapshot;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [name, counter] : counters_) {
+        snapshot.counters.emplace_back(name, counter->Value());
+    }
+    for (auto& [name, gauge] : gauges_) {
+        snapshot.gauges.emplace_back(name, gauge->Value());
+    }
+    for (auto& [name, histogram] : histograms_) {
+        snapshot.histograms.emplace_back(name, histogram->Sample());
+    }
+    // Holding the lock keeps a collector from being removed, and its owner
+    // destroyed, while it runs
+    for (auto& [id, collector] : collectors_) {
+        collector(snapshot.report);
+    }
+    return snapshot;
+}
+
+void WriteMetricsText(const MetricsSnapshot& snapshot, std::ostream& out) {
+    out << "                   Average     Minimum     Maximum     "
+           "Variance    Standard Deviation     \n";
+    for (auto& [name, statistics] : snapshot.report.time_statistics) {
+        WriteTimeStatistics(out, name, statistics);
+    }
+    for (auto& [name, value] : snapshot.report.counters) {
+        out << name << ": " << value << "\n";
+    }
+    for (auto& [name, value] : snapshot.report.values) {
+        out << name << ": " << value << "\n";
+    }
+    for (auto& [name, value] : snapshot.counters) {
+        out << name << ": " << value << "\n";
+    }
+    for (auto& [name, value] : snapshot.gauges) {
+        out << name << ": " << value << "\n";
+    }
+    for (auto& [name, sample] : snapshot.histograms) {
+        auto average = sample.count ? sample.sum / sample.count : 0.0;
+        out << name << ": count " << sample.count << std::scientific
+            << std::setprecision(2) << ", average " << average << ", p50 <= "
+            << sample.Quantile(0.5) << ", p99 <= " << sample.Quantile(0.99)
+            << std::defaultfloat << "\n";
+    }
+}
+
+void WritePrometheusText(const MetricsSnapshot& snapshot, std::ostream& out,
+                         const std::string& prefix) {
+    std::set<std::string> written;
+    for (auto& [name, value] : snapshot.counters) {
+        auto metric = MetricName(prefix, name);
+        if (WriteFamily(written, out, metric, name, "counter")) {
+            out << metric << " " << value << "\n";
+        }
+    }
+    for (auto& [name, value] : snapshot.gauges) {
+        auto metric = MetricName(prefix, name);
+        if (WriteFamily(written, out, metric, name, "gauge")) {
+            out << metric << " " << FormatValue(value) << "\n";
+        }
+    }
+    for (auto& [name, sample] : snapshot.histograms) {
+        auto metric = MetricName(prefix, name);
+        if (!WriteFamily(written, out, metric, name, "histogram")) {
+            continue;
+        }
+        // Buckets are cumulative in the exposition format
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < sample.counts.size(); i++) {
+            cumulative += sample.counts[i];
+            auto bound = i < sample.bounds.size()
+                             ? FormatValue(sample.bounds[i])
+                             : std::string("+Inf");
+            out << metric << "_bucket{le=\"" << bound << "\"} " << cumulative
+                << "\n";
+        }
+        out << metric << "_sum " << FormatValue(sample.sum) << "\n";
+        out << metric << "_count " << sample.count << "\n";
+    }
+    for (auto& [name, statistics] : snapshot.report.time_statistics) {
+        auto metric = MetricName(prefix, name) + "_seconds";
+        if (!WriteFamily(written, out, metric, name, "gauge")) {
+            continue;
+        }
+        out << metric << "{stat=\"average\"} "
+            << FormatValue(statistics.average) << "\n";
+        out << metric << "{stat=\"minimum\"} "
+            << FormatValue(statistics.minimum) << "\n";
+        out << metric << "{stat=\"maximum\"} "
+            << FormatValue(statistics.maximum) << "\n";
+        out << metric << "{stat=\"standard_deviation\"} "
+            << FormatValue(statistics.standard_deviation) << "\n";
+    }
+    for (auto& [name, value] : snapshot.report.counters) {
+        auto metric = MetricName(prefix, name);
+        if (WriteFamily(written, out, metric, name, "untyped")) {
+            out << metric << " " << value << "\n";
+        }
+    }
+    for (auto& [name, value] : snapshot.report.values) {
+        auto metric = MetricName(prefix, name);
+        if (WriteFamily(written, out, metric, name, "gauge")) {
+            out << metric << " " << FormatValue(value) << "\n";
+        }
+    }
+}
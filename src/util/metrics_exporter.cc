@@ -0,0 +1,277 @@
+/******************************************************************************
+ * Filename:    metrics_exporter.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "metrics_exporter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "error_handling.h"
+#include "logger.h"
+
+namespace {
+constexpr int kPollTimeoutMs = 200;
+constexpr int kSocketTimeoutMs = 200;
+
+double Seconds(const timeval& time) {
+    return static_cast<double>(time.tv_sec) +
+           static_cast<double>(time.tv_usec) * 1.0e-6;
+}
+
+// The standard process metrics, so CPU time and memory can be graphed next to
+// the pipeline's own
+void WriteProcessMetrics(std::ostream& out) {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        out << "# TYPE process_cpu_seconds_total counter\n"
+            << "process_cpu_seconds_total "
+            << std::to_string(Seconds(usage.ru_utime) +
+                              Seconds(usage.ru_stime))
+            << "\n";
+    }
+
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size_pages = 0;
+    std::size_t resident_pages = 0;
+    if (statm >> size_pages >> resident_pages) {
+        auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        out << "# TYPE process_resident_memory_bytes gauge\n"
+            << "process_resident_memory_bytes " << resident_pages * page_size
+            << "\n"
+            << "# TYPE process_virtual_memory_bytes gauge\n"
+            << "process_virtual_memory_bytes " << size_pages * page_size
+            << "\n";
+    }
+}
+
+bool SendAll(int socket, const std::string& data) {
+    const char* bytes = data.data();
+    std::size_t size = data.size();
+    while (size > 0) {
+        auto sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Includes a scraper too slow to drain the send timeout
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+std::string Response(const std::string& status, const std::string& type,
+                     const std::string& body) {
+    return "HTTP/1.0 " + status +
+           "\r\n"
+           "Content-Type: " +
+           type +
+           "\r\n"
+           "Content-Length: " +
+           std::to_string(body.size()) +
+           "\r\n"
+           "Connection: close\r\n\r\n" +
+           body;
+}
+}  // namespace
+
+MetricsExporter::MetricsExporter(const MetricsExporterConfig& config)
+    : config_(config),
+      task_(TaskId::METRICS_EXPORTER, TaskPriority::METRICS_EXPORTER,
+            TaskUpdatePeriodMs(kPollTimeoutMs), TaskFcn),
+      listen_socket_(-1),
+      unix_socket_bound_(false),
+      unix_socket_device_(0),
+      unix_socket_inode_(0),
+      stopping_(false),
+      scrapes_total_(MetricsRegistry::instance().GetCounter(
+          std::string(TaskName(TaskId::METRICS_EXPORTER)) + "_scrapes_total")),
+      render_histogram_(MetricsRegistry::instance().GetHistogram(
+          std::string(TaskName(TaskId::METRICS_EXPORTER)) +
+          "_render_seconds")) {
+    if (config_.unix_path.empty()) {
+        OpenTcpSocket();
+    } else {
+        OpenUnixSocket();
+    }
+    task_.SetData(this);
+    task_.Start();
+    spdlog::info("Metrics available at {}", Address());
+}
+
+MetricsExporter::~MetricsExporter() {
+    stopping_ = true;
+    task_.Join();
+    close(listen_socket_);
+    // Something else may have taken the path since
+    struct stat info;
+    if (unix_socket_bound_ && lstat(config_.unix_path.c_str(), &info) == 0 &&
+        S_ISSOCK(info.st_mode) && info.st_dev == unix_socket_device_ &&
+        info.st_ino == unix_socket_inode_) {
+        unlink(config_.unix_path.c_str());
+    }
+}
+
+std::string MetricsExporter::Address() const {
+    if (!config_.unix_path.empty()) {
+        return "unix:" + config_.unix_path + " (/metrics)";
+    }
+    return "http://" + config_.bind_address + ":" +
+           std::to_string(config_.port) + "/metrics";
+}
+
+void MetricsExporter::OpenTcpSocket() {
+    listen_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_socket_ < 0) {
+        throw DiagnosticsException("Failed to create metrics socket: " +
+                                   std::string(strerror(errno)));
+    }
+
+    int reuse = 1;
+    setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse,
+               sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config_.port);
+    if (inet_pton(AF_INET, config_.bind_address.c_str(), &address.sin_addr) !=
+            1 ||
+        bind(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listen_socket_, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        close(listen_socket_);
+        throw DiagnosticsException("Failed to listen on " +
+                                   config_.bind_address + ":" +
+                                   std::to_string(config_.port) + ": " +
+                                   error);
+    }
+}
+
+void MetricsExporter::OpenUnixSocket() {
+    sockaddr_un address{};
+    if (config_.unix_path.size() >= sizeof(address.sun_path)) {
+        throw DiagnosticsException("Metrics socket path is too long: " +
+                                   config_.unix_path);
+    }
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, config_.unix_path.c_str(),
+                 sizeof(address.sun_path) - 1);
+
+    listen_socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_socket_ < 0) {
+        throw DiagnosticsException("Failed to create metrics socket: " +
+                                   std::string(strerror(errno)));
+    }
+
+    // A socket left behind by a previous run would make bind fail, but a
+    // mistyped path must not cost anyone their file
+    struct stat info;
+    if (lstat(config_.unix_path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            close(listen_socket_);
+            throw DiagnosticsException("Metrics socket path " +
+                                       config_.unix_path +
+                                       " exists and isn't a socket");
+        }
+        unlink(config_.unix_path.c_str());
+    }
+    if (bind(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listen_socket_, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        close(listen_socket_);
+        throw DiagnosticsException("Failed to listen on " + config_.unix_path +
+                                   ": " + error);
+    }
+    if (lstat(config_.unix_path.c_str(), &info) == 0) {
+        unix_socket_bound_ = true;
+        unix_socket_device_ = info.st_dev;
+        unix_socket_inode_ = info.st_ino;
+    }
+}
+
+void MetricsExporter::TaskFcn(Task* task) {
+    MetricsExporter* self = static_cast<MetricsExporter*>(task->GetData());
+
+    pollfd listen_poll{self->listen_socket_, POLLIN, 0};
+    while (!self->stopping_) {
+        if (poll(&listen_poll, 1, task->period_ms_.count()) <= 0 ||
+            !(listen_poll.revents & POLLIN)) {
+            continue;
+        }
+        int socket = accept(self->listen_socket_, nullptr, nullptr);
+        if (socket < 0) {
+            continue;
+        }
+        self->ServeClient(socket);
+        close(socket);
+    }
+}
+
+void MetricsExporter::ServeClient(int socket) {
+    // Bound the exchange so a stuck scraper cannot hold up the next one
+    timeval timeout{0, kSocketTimeoutMs * 1000};
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line matters
+    char request[1024];
+    auto received = recv(socket, request, sizeof(request) - 1, 0);
+    if (received <= 0) {
+        return;
+    }
+    request[received] = '\0';
+    std::istringstream request_line(request);
+    std::string method;
+    std::string path;
+    request_line >> method >> path;
+
+    if (method != "GET") {
+        SendAll(socket, Response("405 Method Not Allowed", "text/plain",
+                                 "Only GET is supported\n"));
+        return;
+    }
+    if (path != "/metrics" && path != "/") {
+        SendAll(socket,
+                Response("404 Not Found", "text/plain", "Try /metrics\n"));
+        return;
+    }
+
+    SendAll(socket, Response("200 OK",
+                             "text/plain; version=0.0.4; charset=utf-8",
+                             Render()));
+}
+
+std::string MetricsExporter::Render() {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    scrapes_total_->Add();
+    std::ostringstream body;
+    WritePrometheusText(MetricsRegistry::instance().Snapshot(), body);
+    WriteProcessMetrics(body);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed_time_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                             start_time)
+            .count();
+    // Shows up in the next scrape
+    render_histogram_->Observe(static_cast<double>(elapsed_time_ns) * 1.0e-9);
+    return body.str();
+}
@@ -0,0 +1,195 @@
+/******************************************************************************
+ * Filename:    perf_counters.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "logger.h"
+
+namespace {
+
+struct EventConfig {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+// In the order of PerfCounters::Event
+constexpr EventConfig kEvents[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+// Counts the calling thread on whichever CPU it runs
+int OpenEvent(const EventConfig& event, int group_fd) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                      group_fd, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        // perf_event_paranoid may only allow counting user space
+        attr.exclude_kernel = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                      group_fd, PERF_FLAG_FD_CLOEXEC));
+    }
+    return fd;
+}
+
+}  // namespace
+
+PerfCounters::~PerfCounters() { Close(); }
+
+void PerfCounters::SetEnabled(bool enabled) { enabled_ = enabled; }
+
+bool PerfCounters::OpenGroup(Event first, Event last) {
+    for (int event = first; event < last; event++) {
+        auto group_fd = event == first ? -1 : fds_[first];
+        fds_[event] = OpenEvent(kEvents[event], group_fd);
+        if (fds_[event] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PerfCounters::Open() {
+    bool has_hardware = OpenGroup(CYCLES, CPU_TIME);
+    if (!has_hardware) {
+        for (int event = CYCLES; event < CPU_TIME; event++) {
+            if (fds_[event] >= 0) {
+                close(fds_[event]);
+                fds_[event] = -1;
+            }
+        }
+    }
+    if (!OpenGroup(CPU_TIME, EVENT_COUNT)) {
+        spdlog::warn("Perf counters are unavailable: {}", strerror(errno));
+        Close();
+        return false;
+    }
+    if (!has_hardware) {
+        spdlog::info("No hardware perf counters, counting in software only");
+    }
+    has_hardware_ = has_hardware;
+    return true;
+}
+
+void PerfCounters::Close() {
+    for (auto& fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    open_ = false;
+    active_ = false;
+}
+
+bool PerfCounters::ReadGroup(Event first, Event last, Values& values) {
+    // nr, time enabled, time running, then one value per event
+    std::uint64_t buffer[3 + EVENT_COUNT];
+    auto count = static_cast<std::size_t>(last - first);
+    auto size = (3 + count) * sizeof(std::uint64_t);
+    if (read(fds_[first], buffer, size) != static_cast<ssize_t>(size) ||
+        buffer[0] != count) {
+        return false;
+    }
+    // Scale up for the time the group was multiplexed off the PMU
+    double scale =
+        buffer[2] > 0 ? static_cast<double>(buffer[1]) / buffer[2] : 0.0;
+    for (std::size_t i = 0; i < count; i++) {
+        values[first + i] = static_cast<double>(buffer[3 + i]) * scale;
+    }
+    return true;
+}
+
+bool PerfCounters::Read(Values& values) {
+    if (has_hardware_ && !ReadGroup(CYCLES, CPU_TIME, values)) {
+        return false;
+    }
+    return ReadGroup(CPU_TIME, EVENT_COUNT, values);
+}
+
+void PerfCounters::Begin() {
+    if (!Enabled()) {
+        if (open_) {
+            Close();
+        }
+        // Try again the next time counting is enabled
+        failed_ = false;
+        return;
+    }
+    if (!open_ && !failed_) {
+        open_ = Open();
+        failed_ = !open_;
+    }
+    active_ = open_ && Read(begin_);
+}
+
+void PerfCounters::End() {
+    if (!active_) {
+        return;
+    }
+    active_ = false;
+    Values end;
+    if (!Read(end)) {
+        return;
+    }
+
+    cpu_time_.Push((end[CPU_TIME] - begin_[CPU_TIME]) * 1.0e-9);
+    context_switches_.Push(end[CONTEXT_SWITCHES] - begin_[CONTEXT_SWITCHES]);
+    page_faults_.Push(end[PAGE_FAULTS] - begin_[PAGE_FAULTS]);
+    if (has_hardware_) {
+        auto cycles = end[CYCLES] - begin_[CYCLES];
+        auto instructions = end[INSTRUCTIONS] - begin_[INSTRUCTIONS];
+        cycles_.Push(cycles);
+        instructions_.Push(instructions);
+        if (cycles > 0.0) {
+            ipc_.Push(instructions / cycles);
+        }
+        cache_misses_.Push(end[CACHE_MISSES] - begin_[CACHE_MISSES]);
+        branch_misses_.Push(end[BRANCH_MISSES] - begin_[BRANCH_MISSES]);
+    }
+    frames_++;
+}
+
+void PerfCounters::ReportDiagnostics(const std::string& prefix,
+                                     DiagnosticsReport& report) {
+    if (frames_ == 0) {
+        return;
+    }
+    report.AddTimeStatistics(prefix + " CPU Time", cpu_time_.GetStatistics());
+    report.AddValue(prefix + " Context Switches Per Frame",
+                    context_switches_.GetStatistics().average);
+    report.AddValue(prefix + " Page Faults Per Frame",
+                    page_faults_.GetStatistics().average);
+    if (!has_hardware_) {
+        return;
+    }
+    report.AddValue(prefix + " IPC", ipc_.GetStatistics().average);
+    report.AddValue(prefix + " Cycles Per Frame",
+                    cycles_.GetStatistics().average);
+    report.AddValue(prefix + " Instructions Per Frame",
+                    instructions_.GetStatistics().average);
+    report.AddValue(prefix + " Cache Misses Per Frame",
+                    cache_misses_.GetStatistics().average);
+    report.AddValue(prefix + " Branch Misses Per Frame",
+                    branch_misses_.GetStatistics().average);
+}
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Filename:    profiled_mutex.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "profiled_mutex.h"
+
+LockProfiler& LockProfiler::instance() {
+    static LockProfiler profiler;
+    return profiler;
+}
+
+LockProfile* LockProfiler::Get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& profile = profiles_[name];
+    if (!profile) {
+        profile = std::make_unique<LockProfile>(name);
+    }
+    return profile.get();
+}
+
+void LockProfiler::ReportDiagnostics(DiagnosticsReport& report) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [name, profile] : profiles_) {
+        auto prefix = "Lock " + name;
+        auto acquisitions = profile->acquisitions.load();
+        auto waits = profile->waits.load();
+        report.AddCounter(prefix + " Acquisitions", acquisitions);
+        report.AddCounter(prefix + " Contentions", profile->contentions);
+        report.AddValue(prefix + " Wait Seconds", profile->wait_ns * 1.0e-9);
+        report.AddValue(prefix + " Max Wait Seconds",
+                        profile->max_wait_ns * 1.0e-9);
+        if (acquisitions > 0) {
+            report.AddValue(prefix + " Contention Ratio",
+                            static_cast<double>(profile->contentions) /
+                                acquisitions);
+            report.AddValue(prefix + " Average Hold Seconds",
+                            profile->hold_ns * 1.0e-9 / acquisitions);
+        }
+        report.AddValue(prefix + " Max Hold Seconds",
+                        profile->max_hold_ns * 1.0e-9);
+        if (waits == 0 && profile->lost_notifies == 0) {
+            continue;
+        }
+        report.AddCounter(prefix + " Waits", waits);
+        report.AddCounter(prefix + " Timeouts", profile->timeouts);
+        report.AddCounter(prefix + " Spurious Wakeups",
+                          profile->spurious_wakeups);
+        report.AddCounter(prefix + " Lost Notifies", profile->lost_notifies);
+    }
+}
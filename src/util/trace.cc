@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Filename:    trace.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "trace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <tuple>
+
+#include "error_handling.h"
+
+namespace {
+
+thread_local std::string trace_thread_name;
+
+// Marks the ring of a thread that has exited, so Start() can drop it
+struct RingHandle {
+    std::shared_ptr<TraceRing> ring;
+    ~RingHandle() {
+        if (ring) {
+            ring->exited_ = true;
+        }
+    }
+};
+thread_local RingHandle ring_handle;
+
+struct FlowPoint {
+    std::uint64_t frame;
+    std::uint64_t begin;
+    int thread_id;
+};
+
+}  // namespace
+
+TraceRing::TraceRing(std::size_t capacity, const std::string& thread_name)
+    : slots_(capacity),
+      mask_(capacity - 1),
+      thread_name_(thread_name),
+      thread_id_(static_cast<int>(syscall(SYS_gettid))) {}
+
+void TraceRing::Record(const TraceEvent& event) {
+    auto index = head_.load(std::memory_order_relaxed);
+    auto& slot = slots_[index & mask_];
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.begin.store(event.begin, std::memory_order_relaxed);
+    slot.end.store(event.end, std::memory_order_relaxed);
+    slot.frame.store(event.frame, std::memory_order_relaxed);
+    head_.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceRing::Read() const {
+    auto capacity = static_cast<std::uint64_t>(slots_.size());
+    auto head = head_.load(std::memory_order_acquire);
+    auto first = head > capacity ? head - capacity : 0;
+    std::vector<TraceEvent> events;
+    events.reserve(head - first);
+    for (auto index = first; index < head; index++) {
+        auto& slot = slots_[index & mask_];
+        TraceEvent event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.begin = slot.begin.load(std::memory_order_relaxed);
+        event.end = slot.end.load(std::memory_order_relaxed);
+        event.frame = slot.frame.load(std::memory_order_relaxed);
+        events.push_back(event);
+    }
+
+    // The writer may have lapped the oldest slots while they were copied,
+    // including the one it is writing now
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto latest = head_.load(std::memory_order_relaxed);
+    if (latest + 1 > first + capacity) {
+        auto overwritten = std::min<std::uint64_t>(
+            latest + 1 - capacity - first, events.size());
+        events.erase(events.begin(), events.begin() + overwritten);
+    }
+    return events;
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                [](const std::shared_ptr<TraceRing>& ring) {
+                                    return ring->exited_.load();
+                                }),
+                 rings_.end());
+    start_timestamp_ = TraceTimestamp();
+    start_time_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+}
+
+void Tracer::Stop() { enabled_ = false; }
+
+void Tracer::SetThreadName(const std::string& name) {
+    trace_thread_name = name;
+}
+
+void Tracer::Record(const char* name, std::uint64_t begin, std::uint64_t end,
+                    std::uint64_t frame) {
+    // A span that was open when tracing stopped
+    if (!Enabled()) {
+        return;
+    }
+    Ring().Record(TraceEvent{name, begin, end, frame});
+}
+
+TraceRing& Tracer::Ring() {
+    if (!ring_handle.ring) {
+        auto ring = std::make_shared<TraceRing>(
+            kRingCapacity,
+            trace_thread_name.empty() ? "thread" : trace_thread_name);
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring);
+        ring_handle.ring = std::move(ring);
+    }
+    return *ring_handle.ring;
+}
+
+std::size_t Tracer::WriteChromeTrace(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out) {
+        throw DiagnosticsException("Failed to open trace file " + filename);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Calibrate ticks against the steady clock over the whole trace
+    auto end_timestamp = TraceTimestamp();
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start_time_;
+    auto ticks = end_timestamp - start_timestamp_;
+    double us_per_tick = ticks > 0 ? elapsed.count() / ticks : 1.0e-3;
+    auto to_us = [&](std::uint64_t timestamp) {
+        return static_cast<double>(timestamp - start_timestamp_) * us_per_tick;
+    };
+
+    auto pid = static_cast<int>(getpid());
+    std::size_t spans = 0;
+    std::vector<FlowPoint> flow_points;
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"args\":{\"name\":\"spp_app\"}}";
+    for (auto& ring : rings_) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":" << ring->ThreadId() << ",\"args\":{\"name\":\""
+            << ring->ThreadName() << "\"}}";
+        for (auto& event : ring->Read()) {
+            if (event.begin < start_timestamp_ || event.end < event.begin) {
+                continue;
+            }
+            out << ",\n{\"name\":\"" << event.name
+                << "\",\"cat\":\"spp\",\"ph\":\"X\",\"pid\":" << pid
+                << ",\"tid\":" << ring->ThreadId()
+                << ",\"ts\":" << to_us(event.begin)
+                << ",\"dur\":" << to_us(event.end) - to_us(event.begin);
+            if (event.frame != 0) {
+                out << ",\"args\":{\"frame\":" << event.frame << "}";
+                flow_points.push_back(
+                    FlowPoint{event.frame, event.begin, ring->ThreadId()});
+            }
+            out << "}";
+            spans++;
+        }
+    }
+
+    // Arrows from each span of a frame to the next one on another thread
+    std::sort(flow_points.begin(), flow_points.end(),
+              [](const FlowPoint& a, const FlowPoint& b) {
+                  return std::tie(a.frame, a.begin) <
+                         std::tie(b.frame, b.begin);
+              });
+    std::uint64_t flow_id = 0;
+    for (std::size_t i = 1; i < flow_points.size(); i++) {
+        auto& from = flow_points[i - 1];
+        auto& to = flow_points[i];
+        if (from.frame != to.frame || from.thread_id == to.thread_id) {
+            continue;
+        }
+        flow_id++;
+        out << ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"s\",\"id\":"
+            << flow_id << ",\"pid\":" << pid << ",\"tid\":" << from.thread_id
+            << ",\"ts\":" << to_us(from.begin) << "}";
+        out << ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"f\","
+               "\"bp\":\"e\",\"id\":"
+            << flow_id << ",\"pid\":" << pid << ",\"tid\":" << to.thread_id
+            << ",\"ts\":" << to_us(to.begin) << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return spans;
+}
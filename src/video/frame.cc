@@ -0,0 +1,111 @@
+/******************************************************************************
+ * Filename:    frame.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "frame.h"
+
+namespace {
+
+// True while some cv::Mat header other than the given one shares the pixels
+bool PixelsShared(const cv::Mat& mat) {
+    return mat.u != nullptr && mat.u->refcount > 1;
+}
+
+}  // namespace
+
+const cv::Mat& Frame::Read() const {
+    static const cv::Mat kEmpty;
+    return mat_ ? *mat_ : kEmpty;
+}
+
+cv::Mat& Frame::Write() {
+    if (!pool_) {
+        pool_ = std::make_shared<FramePool>();
+    }
+    if (!mat_) {
+        *this = pool_->Acquire();
+        return *mat_;
+    }
+    if (IsShared()) {
+        auto copy = pool_->Acquire();
+        mat_->copyTo(*copy.mat_);
+        mat_ = std::move(copy.mat_);
+        pool_->copies_++;
+    } else {
+        pool_->writes_in_place_++;
+    }
+    return *mat_;
+}
+
+bool Frame::IsShared() const {
+    // Only this handle can create new references, so a use count of one
+    // can't change under us
+    return mat_.use_count() > 1 || PixelsShared(*mat_);
+}
+
+FramePool::FramePool(std::size_t max_free)
+    : max_free_(max_free),
+      frames_allocated_(0),
+      frames_recycled_(0),
+      copies_(0),
+      writes_in_place_(0) {}
+
+Frame FramePool::Acquire() {
+    cv::Mat mat;
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        while (!free_.empty()) {
+            mat = std::move(free_.back());
+            free_.pop_back();
+            if (!PixelsShared(mat)) {
+                break;
+            }
+            mat.release();
+        }
+    }
+    if (mat.empty()) {
+        frames_allocated_++;
+    } else {
+        frames_recycled_++;
+    }
+    return Wrap(std::move(mat));
+}
+
+Frame FramePool::Adopt(const cv::Mat& mat, PixelFormat format) {
+    auto frame = Wrap(cv::Mat(mat));
+    frame.SetFormat(format);
+    return frame;
+}
+
+Frame FramePool::Wrap(cv::Mat&& mat) {
+    std::weak_ptr<FramePool> pool = shared_from_this();
+    auto deleter = [pool](cv::Mat* released) {
+        if (auto owner = pool.lock()) {
+            owner->Recycle(std::move(*released));
+        }
+        delete released;
+    };
+    return Frame(std::shared_ptr<cv::Mat>(new cv::Mat(std::move(mat)), deleter),
+                 shared_from_this());
+}
+
+void FramePool::Recycle(cv::Mat&& mat) {
+    // A submatrix, e.g. the Y plane of a YUV frame, is a view into a buffer
+    // owned by someone else and not worth keeping
+    if (mat.empty() || mat.isSubmatrix() || PixelsShared(mat)) {
+        return;
+    }
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (free_.size() < max_free_) {
+        free_.push_back(std::move(mat));
+    }
+}
+
+void FramePool::ReportDiagnostics(const std::string& prefix,
+                                  DiagnosticsReport& report) {
+    report.AddCounter(prefix + " Frames Allocated", frames_allocated_);
+    report.AddCounter(prefix + " Frames Recycled", frames_recycled_);
+    report.AddCounter(prefix + " Copy-On-Write Copies", copies_);
+    report.AddCounter(prefix + " In-Place Writes", writes_in_place_);
+}
@@ -0,0 +1,210 @@
+/******************************************************************************
+ * Filename:    frame_views.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "frame_views.h"
+
+#include <algorithm>
+
+#include "error_handling.h"
+#include "opencv2/imgproc.hpp"
+
+namespace {
+
+std::size_t Index(PixelFormat format) {
+    return static_cast<std::size_t>(format);
+}
+
+// Returns -1 when there is no direct conversion
+int ConversionCode(PixelFormat from, PixelFormat to) {
+    if (from == PixelFormat::BGR && to == PixelFormat::GRAY) {
+        return cv::COLOR_BGR2GRAY;
+    } else if (from == PixelFormat::BGR && to == PixelFormat::HSV) {
+        return cv::COLOR_BGR2HSV;
+    } else if (from == PixelFormat::GRAY && to == PixelFormat::BGR) {
+        return cv::COLOR_GRAY2BGR;
+    } else if (from == PixelFormat::HSV && to == PixelFormat::BGR) {
+        return cv::COLOR_HSV2BGR;
+    } else if (from == PixelFormat::BGR && to == PixelFormat::I420) {
+        return cv::COLOR_BGR2YUV_I420;
+    } else if (from == PixelFormat::I420 && to == PixelFormat::BGR) {
+        return cv::COLOR_YUV2BGR_I420;
+    } else if (from == PixelFormat::NV12 && to == PixelFormat::BGR) {
+        return cv::COLOR_YUV2BGR_NV12;
+    }
+    return -1;
+}
+
+}  // namespace
+
+const char* PixelFormatName(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::ANY:
+            return "any";
+        case PixelFormat::BGR:
+            return "bgr";
+        case PixelFormat::GRAY:
+            return "gray";
+        case PixelFormat::HSV:
+            return "hsv";
+        case PixelFormat::I420:
+            return "i420";
+        case PixelFormat::NV12:
+            return "nv12";
+        default:
+            return "unknown";
+    }
+}
+
+bool IsYuv420(PixelFormat format) {
+    return format == PixelFormat::I420 || format == PixelFormat::NV12;
+}
+
+cv::Size FitSize(cv::Size size, cv::Size max_size) {
+    double scale = 1.0;
+    if (max_size.width > 0 && size.width > 0) {
+        scale = std::min(scale,
+                         static_cast<double>(max_size.width) / size.width);
+    }
+    if (max_size.height > 0 && size.height > 0) {
+        scale = std::min(scale,
+                         static_cast<double>(max_size.height) / size.height);
+    }
+    if (scale >= 1.0) {
+        return size;
+    }
+    return cv::Size(std::max(1, static_cast<int>(size.width * scale)),
+                    std::max(1, static_cast<int>(size.height * scale)));
+}
+
+void FrameViews::Reset(const cv::Mat& frame, PixelFormat format) {
+    frame_ = frame;
+    format_ = format;
+    valid_.fill(false);
+    for (auto& level : levels_) {
+        level.valid = false;
+    }
+    overlays_.clear();
+}
+
+void FrameViews::Rebase(const cv::Mat& frame, PixelFormat format) {
+    frame_ = frame;
+    format_ = format;
+    valid_.fill(false);
+    for (auto& level : levels_) {
+        level.valid = false;
+    }
+}
+
+void FrameViews::Clear() { Reset(cv::Mat(), format_); }
+
+const cv::Mat& FrameViews::View(PixelFormat format) {
+    if (format == PixelFormat::ANY || format == format_) {
+        return frame_;
+    }
+    if (!valid_[Index(format)]) {
+        Convert(format);
+    }
+    return views_[Index(format)];
+}
+
+const cv::Mat& FrameViews::View(PixelFormat format, cv::Size max_size) {
+    auto& full = View(format);
+    auto size = FitSize(full.size(), max_size);
+    if (size == full.size()) {
+        return full;
+    }
+
+    // Resizing a level that is already small is cheaper than starting from
+    // the full frame
+    const cv::Mat* source = &full;
+    Level* slot = nullptr;
+    for (auto& level : levels_) {
+        if (level.format != format && level.valid) {
+            continue;
+        }
+        if (level.valid && level.mat.size() == size) {
+            return level.mat;
+        } else if (level.valid && level.mat.cols >= size.width &&
+                   level.mat.rows >= size.height &&
+                   level.mat.cols < source->cols) {
+            source = &level.mat;
+        } else if (!level.valid &&
+                   (!slot || level.mat.size() == size)) {
+            // Prefer the buffer that held this size on the last frame
+            slot = &level;
+        }
+    }
+    if (!slot) {
+        levels_.push_back(Level{format, cv::Mat(), false});
+        slot = &levels_.back();
+    }
+    cv::resize(*source, slot->mat, size, 0, 0, cv::INTER_AREA);
+    slot->format = format;
+    slot->valid = true;
+    resizes_++;
+    return slot->mat;
+}
+
+cv::Mat FrameViews::Take(PixelFormat format) {
+    if (format == PixelFormat::ANY || format == format_) {
+        return frame_;
+    }
+    // The caller keeps the view as its output frame, so the buffer can't be
+    // reused for the next frame
+    View(format);
+    valid_[Index(format)] = false;
+    return std::move(views_[Index(format)]);
+}
+
+void FrameViews::AddOverlay(const cv::Rect& rect, const cv::Scalar& color) {
+    overlays_.emplace_back(rect, color);
+}
+
+void FrameViews::MoveOverlays(FrameViews& target, cv::Point offset) {
+    for (auto& [rect, color] : overlays_) {
+        target.AddOverlay(rect + offset, color);
+    }
+    overlays_.clear();
+}
+
+void FrameViews::DrawOverlays(cv::Mat& frame) {
+    if (overlays_.empty()) {
+        return;
+    }
+    // On a YUV frame the boxes land on the Y plane, since all of them lie
+    // within the image rows
+    for (auto& [rect, color] : overlays_) {
+        cv::rectangle(frame, rect, color, 2);
+    }
+    overlays_.clear();
+    // The pixels changed, so every view has to be derived again
+    Reset(frame, format_);
+}
+
+void FrameViews::Convert(PixelFormat format) {
+    if (IsYuv420(format_) && format == PixelFormat::GRAY) {
+        // The Y plane is a full resolution gray image, so this is a header
+        // into the frame rather than a conversion
+        views_[Index(format)] = frame_.rowRange(0, frame_.rows * 2 / 3);
+        valid_[Index(format)] = true;
+        return;
+    }
+    auto code = ConversionCode(format_, format);
+    if (code >= 0) {
+        cv::cvtColor(frame_, views_[Index(format)], code);
+    } else {
+        // e.g. HSV to gray goes through BGR, which is cached as well
+        auto from_bgr = ConversionCode(PixelFormat::BGR, format);
+        if (from_bgr < 0) {
+            throw VideoProcessingException(
+                std::string("No conversion from ") + PixelFormatName(format_) +
+                " to " + PixelFormatName(format));
+        }
+        auto& bgr = View(PixelFormat::BGR);
+        cv::cvtColor(bgr, views_[Index(format)], from_bgr);
+    }
+    valid_[Index(format)] = true;
+    conversions_++;
+}
@@ -6,12 +6,16 @@
 #include "video_input.h"
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <mutex>
 
+#include "flight_recorder.h"
 #include "logger.h"
 #include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
 #include "task.h"
+#include "trace.h"
 #include "video_task.h"
 
 VideoInput::VideoInput(std::shared_ptr<VideoSourceFactory> source_factory,
@@ -20,6 +24,8 @@ VideoInput::VideoInput(std::shared_ptr<VideoSourceFactory> source_factory,
                        std::atomic<bool>& shutting_down)
     : VideoTask(id, priority, update_period, TaskFcn, shutting_down),
       source_factory_(source_factory),
+      frame_format_(PixelFormat::BGR),
+      next_frame_id_(1),
       running_(false) {
     source_ = source_factory_->Create();
     task_.SetData(this);
@@ -41,13 +47,49 @@ void VideoInput::Shutdown() {
     VideoTask::Shutdown();
 }
 
-void VideoInput::GetInputFrame(cv::Mat& frame) { source_->ReadFrame(frame); }
+void VideoInput::GetInputFrame(Frame& frame) {
+    // Capture into a recycled buffer that no reader can still see
+    frame = frame_pool_->Acquire();
+    auto format = frame_format_.load();
+    if (format == PixelFormat::BGR) {
+        source_->ReadFrame(frame.Write());
+        return;
+    }
+
+    // Sources deliver BGR, so the frame is converted once here and every
+    // later stage moves half the bytes
+    source_->ReadFrame(capture_);
+    // Chroma is subsampled 2x2, and cvtColor throws on odd dimensions
+    cv::Rect even(0, 0, capture_.cols & ~1, capture_.rows & ~1);
+    if (even.empty()) {
+        frame = Frame();
+        return;
+    }
+    if (even.size() != capture_.size() && capture_.size() != cropped_size_) {
+        spdlog::warn("Cropping {}x{} input frames to {}x{} for I420",
+                     capture_.cols, capture_.rows, even.width, even.height);
+        cropped_size_ = capture_.size();
+    }
+    cv::cvtColor(capture_(even), frame.Write(), cv::COLOR_BGR2YUV_I420);
+    frame.SetFormat(format);
+}
+
+bool VideoInput::SetFrameFormat(PixelFormat format) {
+    if (format != PixelFormat::BGR && format != PixelFormat::I420) {
+        spdlog::error("Input frames can't be {}", PixelFormatName(format));
+        return false;
+    }
+    frame_format_ = format;
+    spdlog::info("Input frame format: {}", PixelFormatName(format));
+    return true;
+}
 
 void VideoInput::ChangeSource(
     std::shared_ptr<VideoSourceFactory> new_source_factory) {
     Stop();
     source_factory_ = new_source_factory;
     source_ = source_factory_->Create();
+    FlightRecorder::instance().Record("input", "source change", 0, 0.0);
 }
 
 void VideoInput::TaskFcn(Task* task) {
@@ -55,15 +97,32 @@ void VideoInput::TaskFcn(Task* task) {
 
     while (!self->shutting_down_) {
         if (self->running_) {
-            cv::Mat& frame = self->next_buffer_;
-            self->GetInputFrame(frame);
+            Frame frame;
+            auto frame_id = self->next_frame_id_++;
+            auto start_time = std::chrono::high_resolution_clock::now();
+            {
+                TraceSpan span("capture", frame_id);
+                self->perf_counters_.Begin();
+                self->GetInputFrame(frame);
+                self->perf_counters_.End();
+            }
+            // Includes waiting for the device, so this is the capture period
+            // as much as the capture cost
+            std::chrono::duration<double> elapsed_time =
+                std::chrono::high_resolution_clock::now() - start_time;
+            self->time_histogram_->Observe(elapsed_time.count());
+            FlightRecorder::instance().RecordFrame("input", frame_id,
+                                                   elapsed_time.count());
             if (!frame.empty()) {
-                self->SwapBuffers();
+                frame.SetId(frame_id);
+                frame.SetCaptureTime(std::chrono::steady_clock::now());
+                self->Publish(std::move(frame));
                 self->NotifyListeners();
             } else {
                 spdlog::error("Input received an empty frame.");
             }
 
+            TraceSpan span("throttle");
             self->Throttle();
         }
         self->NotifyListeners();
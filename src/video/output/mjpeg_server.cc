@@ -0,0 +1,306 @@
+/******************************************************************************
+ * Filename:    mjpeg_server.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "mjpeg_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "error_handling.h"
+#include "logger.h"
+#include "opencv2/imgcodecs.hpp"
+
+namespace {
+constexpr const char* kBoundary = "sppframe";
+constexpr int kPollTimeoutMs = 200;
+constexpr int kSendTimeoutMs = 200;
+constexpr auto kHangupCheckPeriod = std::chrono::milliseconds(200);
+
+bool ClientHungUp(int socket) {
+    pollfd client_poll{socket, POLLIN | POLLRDHUP, 0};
+    if (poll(&client_poll, 1, 0) <= 0) {
+        return false;
+    }
+    if (client_poll.revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+        return true;
+    }
+    // Readable without POLLRDHUP is either more request data or the end of
+    // the stream
+    char byte;
+    return recv(socket, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+}
+}  // namespace
+
+MjpegServer::MjpegServer(const MjpegServerConfig& config)
+    : config_(config),
+      encoder_task_(TaskId::MJPEG_ENCODER, TaskPriority::MJPEG_ENCODER,
+                    TaskUpdatePeriodMs(0), EncoderTaskFcn),
+      server_task_(TaskId::MJPEG_SERVER, TaskPriority::MJPEG_SERVER,
+                   TaskUpdatePeriodMs(kPollTimeoutMs), ServerTaskFcn),
+      listen_socket_(-1),
+      stopping_(false),
+      frame_pending_(false),
+      latest_sequence_(0),
+      client_count_(0),
+      frames_encoded_(0),
+      frames_skipped_(0) {
+    OpenListenSocket();
+    encoder_task_.SetData(this);
+    server_task_.SetData(this);
+    encoder_task_.Start();
+    server_task_.Start();
+    spdlog::info("MJPEG preview available at http://{}:{}/",
+                 config_.bind_address, config_.port);
+}
+
+MjpegServer::~MjpegServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    frame_cond_.notify_all();
+    jpeg_cond_.notify_all();
+    server_task_.Join();
+    encoder_task_.Join();
+    close(listen_socket_);
+}
+
+void MjpegServer::OpenListenSocket() {
+    listen_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_socket_ < 0) {
+        throw VideoDisplayException("Failed to create MJPEG server socket: " +
+                                    std::string(strerror(errno)));
+    }
+
+    int reuse = 1;
+    setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse,
+               sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config_.port);
+    if (inet_pton(AF_INET, config_.bind_address.c_str(), &address.sin_addr) !=
+            1 ||
+        bind(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listen_socket_, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        close(listen_socket_);
+        throw VideoDisplayException("Failed to listen on " +
+                                    config_.bind_address + ":" +
+                                    std::to_string(config_.port) + ": " +
+                                    error);
+    }
+}
+
+void MjpegServer::Consume(const cv::Mat& frame) {
+    // Nobody is watching, so there is nothing to encode
+    if (client_count_ == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame.copyTo(pending_frame_);
+        frame_pending_ = true;
+    }
+    frame_cond_.notify_one();
+}
+
+void MjpegServer::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddTimeStatistics("MJPEG Encode Time",
+                             encode_time_stats_.GetStatistics());
+    report.AddCounter("MJPEG Clients", client_count_);
+    report.AddCounter("MJPEG Frames Encoded", frames_encoded_);
+    report.AddCounter("MJPEG Frames Skipped", frames_skipped_);
+}
+
+void MjpegServer::EncoderTaskFcn(Task* task) {
+    MjpegServer* self = static_cast<MjpegServer*>(task->GetData());
+    const std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY,
+                                     self->config_.jpeg_quality};
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(self->mutex_);
+            self->frame_cond_.wait(lock, [self] {
+                return self->stopping_ || self->frame_pending_;
+            });
+            if (self->stopping_) {
+                break;
+            }
+            // Hand the previously encoded buffer back to Consume() for reuse
+            std::swap(self->pending_frame_, self->encode_frame_);
+            self->frame_pending_ = false;
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto jpeg = std::make_shared<std::vector<uchar>>();
+        if (!cv::imencode(".jpg", self->encode_frame_, *jpeg, params)) {
+            spdlog::error("MJPEG server failed to encode frame");
+            continue;
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed_time_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                                 start_time)
+                .count();
+        self->encode_time_stats_.Push(static_cast<double>(elapsed_time_ns) *
+                                      1.0e-9);
+        self->frames_encoded_++;
+
+        {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            self->latest_jpeg_ = std::move(jpeg);
+            self->latest_sequence_++;
+        }
+        self->jpeg_cond_.notify_all();
+    }
+}
+
+void MjpegServer::ServerTaskFcn(Task* task) {
+    MjpegServer* self = static_cast<MjpegServer*>(task->GetData());
+
+    pollfd listen_poll{self->listen_socket_, POLLIN, 0};
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            if (self->stopping_) {
+                break;
+            }
+        }
+        if (poll(&listen_poll, 1, task->period_ms_.count()) > 0 &&
+            (listen_poll.revents & POLLIN)) {
+            self->AcceptClient();
+        }
+        self->ReapClients(false);
+    }
+    self->ReapClients(true);
+}
+
+void MjpegServer::AcceptClient() {
+    int socket = accept(listen_socket_, nullptr, nullptr);
+    if (socket < 0) {
+        return;
+    }
+
+    // Bound every blocking send so client threads notice shutdown
+    timeval timeout{0, kSendTimeoutMs * 1000};
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    auto client = std::make_unique<Client>();
+    client->socket = socket;
+    client_count_++;
+    client->thread = std::thread(&MjpegServer::ServeClient, this, client.get());
+    clients_.push_back(std::move(client));
+}
+
+void MjpegServer::ReapClients(bool all) {
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        auto& client = *it;
+        if (all || client->done) {
+            // Unblock a sender that is stuck on a slow viewer
+            shutdown(client->socket, SHUT_RDWR);
+            client->thread.join();
+            close(client->socket);
+            it = clients_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool MjpegServer::SendAll(int socket, const void* data, std::size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        auto sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return false;
+                }
+                continue;
+            }
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+bool MjpegServer::WaitForFrame(int socket, std::uint64_t last_sequence,
+                               MjpegBuffer& buffer, std::uint64_t& sequence) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // A client that left is otherwise only noticed by the next send, and
+    // counts as a viewer until then
+    auto ready = [this, last_sequence] {
+        return stopping_ || latest_sequence_ != last_sequence;
+    };
+    while (!jpeg_cond_.wait_for(lock, kHangupCheckPeriod, ready)) {
+        lock.unlock();
+        auto hung_up = ClientHungUp(socket);
+        lock.lock();
+        if (hung_up) {
+            return false;
+        }
+    }
+    if (stopping_) {
+        return false;
+    }
+    buffer = latest_jpeg_;
+    sequence = latest_sequence_;
+    return true;
+}
+
+void MjpegServer::ServeClient(Client* client) {
+    // The request itself does not matter; every path serves the stream
+    char request[1024];
+    recv(client->socket, request, sizeof(request), 0);
+
+    std::string header =
+        "HTTP/1.0 200 OK\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Pragma: no-cache\r\n"
+        "Connection: close\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=" +
+        std::string(kBoundary) + "\r\n\r\n";
+
+    if (SendAll(client->socket, header.data(), header.size())) {
+        std::uint64_t last_sequence = 0;
+        MjpegBuffer jpeg;
+        std::uint64_t sequence = 0;
+        while (WaitForFrame(client->socket, last_sequence, jpeg, sequence)) {
+            if (last_sequence != 0 && sequence > last_sequence + 1) {
+                frames_skipped_ += sequence - last_sequence - 1;
+            }
+            last_sequence = sequence;
+
+            std::string part = "--" + std::string(kBoundary) +
+                               "\r\n"
+                               "Content-Type: image/jpeg\r\n"
+                               "Content-Length: " +
+                               std::to_string(jpeg->size()) + "\r\n\r\n";
+            if (!SendAll(client->socket, part.data(), part.size()) ||
+                !SendAll(client->socket, jpeg->data(), jpeg->size()) ||
+                !SendAll(client->socket, "\r\n", 2)) {
+                break;
+            }
+        }
+    }
+
+    client_count_--;
+    client->done = true;
+}
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Filename:    shm_frame_publisher.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "shm_frame_publisher.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include "error_handling.h"
+#include "flight_recorder.h"
+#include "logger.h"
+
+ShmFramePublisher::ShmFramePublisher(const std::string& name,
+                                     std::uint32_t slot_count,
+                                     std::size_t slot_capacity)
+    : name_(name),
+      slot_count_(slot_count),
+      slot_capacity_(slot_capacity),
+      ring_(nullptr),
+      ring_size_(0),
+      ring_failed_(false),
+      generation_(0),
+      sequence_(0),
+      frames_published_(0),
+      frames_dropped_(0),
+      ring_recreations_(0) {
+    if (slot_count_ < kShmFramePublisherMinSlots) {
+        throw ShmTransportException(
+            "A frame ring needs at least two slots so readers can finish "
+            "while the next frame is written");
+    }
+    if (slot_count_ > kShmFramePublisherMaxSlots) {
+        throw ShmTransportException("A frame ring can't have more than " +
+                                    std::to_string(kShmFramePublisherMaxSlots) +
+                                    " slots");
+    }
+    if (slot_capacity_ > 0) {
+        CreateRing(slot_capacity_);
+    }
+}
+
+ShmFramePublisher::~ShmFramePublisher() { DestroyRing(); }
+
+void ShmFramePublisher::CreateRing(std::size_t slot_capacity) {
+    // Remove a ring left behind by a publisher that did not shut down cleanly
+    shm_unlink(name_.c_str());
+
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw ShmTransportException("Failed to create frame ring " + name_ +
+                                    ": " + strerror(errno));
+    }
+
+    auto size = ShmFrameRingSize(slot_count_, slot_capacity);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        shm_unlink(name_.c_str());
+        throw ShmTransportException("Failed to size frame ring " + name_ +
+                                    ": " + strerror(errno));
+    }
+
+    void* address =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        shm_unlink(name_.c_str());
+        throw ShmTransportException("Failed to map frame ring " + name_ +
+                                    ": " + strerror(errno));
+    }
+
+    // ftruncate zero fills the segment, so every slot starts with an even
+    // (unwritten) seqlock
+    ring_ = new (address) ShmFrameRingHeader();
+    ring_->version = kShmFrameRingVersion;
+    ring_->slot_count = slot_count_;
+    ring_->generation = ++generation_;
+    ring_->slot_capacity = slot_capacity;
+    ring_->slot_stride = ShmFrameRingSlotStride(slot_capacity);
+    ring_->latest_sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring_->magic = kShmFrameRingMagic;
+
+    ring_size_ = size;
+    slot_capacity_ = slot_capacity;
+    spdlog::info(
+        "Publishing frames to shared memory: {} ({} slots of {} bytes)", name_,
+        slot_count_, slot_capacity_);
+}
+
+void ShmFramePublisher::DestroyRing() {
+    if (ring_ == nullptr) {
+        return;
+    }
+    // Readers keep their own mapping; clearing the magic tells them the ring
+    // is gone
+    ring_->magic = 0;
+    munmap(ring_, ring_size_);
+    shm_unlink(name_.c_str());
+    ring_ = nullptr;
+}
+
+void ShmFramePublisher::WriteSlot(const cv::Mat& frame) {
+    auto sequence = sequence_ + 1;
+    auto* slot = ShmFrameRingSlot(ring_, sequence);
+    auto row_size = frame.cols * frame.elemSize();
+
+    auto seqlock = slot->seqlock.load(std::memory_order_relaxed);
+    slot->seqlock.store(seqlock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->sequence = sequence;
+    slot->timestamp_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    slot->rows = frame.rows;
+    slot->cols = frame.cols;
+    slot->type = frame.type();
+    slot->step = row_size;
+    slot->size = row_size * frame.rows;
+
+    auto* data = ShmFrameRingSlotData(slot);
+    if (frame.isContinuous()) {
+        std::memcpy(data, frame.data, slot->size);
+    } else {
+        for (int row = 0; row < frame.rows; row++) {
+            std::memcpy(data + row * row_size, frame.ptr(row), row_size);
+        }
+    }
+
+    slot->seqlock.store(seqlock + 2, std::memory_order_release);
+    ring_->latest_sequence.store(sequence, std::memory_order_release);
+    sequence_ = sequence;
+}
+
+void ShmFramePublisher::Consume(const cv::Mat& frame) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    auto frame_size = frame.total() * frame.elemSize();
+    if (ring_ == nullptr && !ring_failed_) {
+        try {
+            CreateRing(frame_size);
+        } catch (const ShmTransportException& e) {
+            spdlog::error("{}", e.what());
+            ring_failed_ = true;
+        }
+    }
+    if (ring_ != nullptr && frame_size > slot_capacity_) {
+        // Readers may still be mapped to the current ring, so it can't grow
+        // in place. Clearing its magic sends them to the new one.
+        spdlog::error(
+            "A {} byte frame doesn't fit the {} byte slots of {}, replacing "
+            "the ring",
+            frame_size, slot_capacity_, name_);
+        DestroyRing();
+        ring_recreations_++;
+        try {
+            CreateRing(frame_size);
+        } catch (const ShmTransportException& e) {
+            spdlog::error("{}", e.what());
+            ring_failed_ = true;
+        }
+    }
+    if (ring_ == nullptr) {
+        frames_dropped_++;
+        FlightRecorder::instance().Record("shm", "drop", 0, 1.0);
+        return;
+    }
+
+    WriteSlot(frame);
+    frames_published_++;
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               end_time - start_time)
+                               .count();
+    auto elapsed_time = static_cast<double>(elapsed_time_ns) * 1.0e-9;
+    publish_time_stats_.Push(elapsed_time);
+}
+
+void ShmFramePublisher::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddTimeStatistics("Shm Publish Time",
+                             publish_time_stats_.GetStatistics());
+    report.AddCounter("Shm Frames Published", frames_published_);
+    report.AddCounter("Shm Frames Dropped", frames_dropped_);
+    report.AddCounter("Shm Ring Recreations", ring_recreations_);
+}
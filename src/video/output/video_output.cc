@@ -5,13 +5,17 @@
 
 #include "video_output.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <mutex>
 
+#include "flight_recorder.h"
 #include "logger.h"
 #include "opencv2/core.hpp"
 #include "task.h"
+#include "trace.h"
 #include "video_task.h"
 
 VideoOutput::VideoOutput(VideoTask& input,
@@ -23,7 +27,7 @@ VideoOutput::VideoOutput(VideoTask& input,
       input_(input),
       consumer_factory_(consumer_factory),
       running_(false) {
-    consumer_ = consumer_factory_->Create();
+    consumers_.push_back(consumer_factory_->Create());
     task_.SetData(this);
 }
 
@@ -35,25 +39,113 @@ void VideoOutput::Stop() { running_ = false; }
 
 void VideoOutput::ChangeConsumer(
     std::shared_ptr<VideoConsumerFactory> new_consumer_factory) {
-    consumer_factory_ = new_consumer_factory;
-    consumer_ = consumer_factory_->Create();
+    auto consumer = new_consumer_factory->Create();
+    std::vector<std::shared_ptr<VideoConsumer>> removed;
+    {
+        std::lock_guard<ProfiledMutex> lock(consumers_mutex_);
+        consumer_factory_ = new_consumer_factory;
+        removed.swap(consumers_);
+        consumers_.push_back(consumer);
+    }
+    // The old consumers are destroyed here rather than on the output task
+    WaitForOutputFrame();
+}
+
+std::shared_ptr<VideoConsumer> VideoOutput::AddConsumer(
+    std::shared_ptr<VideoConsumerFactory> consumer_factory) {
+    auto consumer = consumer_factory->Create();
+    if (consumer) {
+        std::lock_guard<ProfiledMutex> lock(consumers_mutex_);
+        consumers_.push_back(consumer);
+    }
+    return consumer;
 }
 
-void VideoOutput::GetInputFrame(cv::Mat& frame) {
-    std::unique_lock<std::mutex> lock(input_.mutex_);
+void VideoOutput::RemoveConsumer(
+    const std::shared_ptr<VideoConsumer>& consumer) {
+    {
+        std::lock_guard<ProfiledMutex> lock(consumers_mutex_);
+        consumers_.erase(
+            std::remove(consumers_.begin(), consumers_.end(), consumer),
+            consumers_.end());
+    }
+    WaitForOutputFrame();
+}
+
+void VideoOutput::WaitForOutputFrame() {
+    // OutputFrame lets go of its copy of the consumers before the lock
+    std::lock_guard<ProfiledMutex> lock(output_mutex_);
+}
+
+void VideoOutput::ReportDiagnostics(DiagnosticsReport& report) {
+    std::lock_guard<ProfiledMutex> lock(consumers_mutex_);
+    for (auto& consumer : consumers_) {
+        consumer->ReportDiagnostics(report);
+    }
+}
+
+void VideoOutput::GetInputFrame(Frame& frame) {
+    std::unique_lock<ProfiledMutex> lock(input_.mutex_);
     input_.cond_.wait(lock);
     input_.GetOutputFrame(frame);
 }
 
-void VideoOutput::OutputFrame(cv::Mat& frame) { consumer_->Consume(frame); }
+void VideoOutput::OutputFrame(const Frame& frame) {
+    std::lock_guard<ProfiledMutex> output_lock(output_mutex_);
+    std::vector<std::shared_ptr<VideoConsumer>> consumers;
+    {
+        std::lock_guard<ProfiledMutex> lock(consumers_mutex_);
+        consumers = consumers_;
+    }
+
+    TraceSpan span("output", frame.Id());
+    perf_counters_.Begin();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    // A YUV frame is converted to BGR at most once, and only if a consumer
+    // asks for it
+    views_.Reset(frame.Read(), frame.Format());
+    for (auto& consumer : consumers) {
+        if (!consumer->WantsFrame()) {
+            continue;
+        }
+        auto format = consumer->InputFormat();
+        if (format == PixelFormat::ANY && IsYuv420(frame.Format())) {
+            format = PixelFormat::BGR;
+        }
+        consumer->Consume(views_.View(format, consumer->InputSize()));
+    }
+    views_.Clear();
+    perf_counters_.End();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               end_time - start_time)
+                               .count();
+    auto elapsed_time = static_cast<double>(elapsed_time_ns) * 1.0e-9;
+    time_stats_.Push(elapsed_time);
+    time_histogram_->Observe(elapsed_time);
+    frames_total_->Add();
+
+    auto& recorder = FlightRecorder::instance();
+    recorder.RecordFrame("output", frame.Id(), elapsed_time);
+    if (frame.CaptureTime() != std::chrono::steady_clock::time_point()) {
+        std::chrono::duration<double> lateness =
+            std::chrono::steady_clock::now() - frame.CaptureTime() -
+            recorder.FrameDeadline();
+        recorder.CheckLateness("output", frame.Id(), lateness.count());
+    }
+}
 
 void VideoOutput::TaskFcn(Task* task) {
     VideoOutput* self = static_cast<VideoOutput*>(task->GetData());
 
-    cv::Mat frame;
     while (!self->shutting_down_) {
         if (self->running_) {
-            self->GetInputFrame(frame);
+            Frame frame;
+            {
+                TraceSpan span("wait for frame");
+                self->GetInputFrame(frame);
+                span.SetFrame(frame.Id());
+            }
             if (!frame.empty()) {
                 self->OutputFrame(frame);
             } else {
@@ -1,16 +1,156 @@
 /******************************************************************************
- * Filename:    video_input.cc
+ * Filename:    video_player.cc
  * Copyright (c) 2023 Keaton Scheible
  *****************************************************************************/
 
 #include "video_player.h"
 
-VideoPlayer::VideoPlayer(const std::string& windowName)
-    : windowName_(windowName) {
-    cv::namedWindow(windowName_, cv::WINDOW_AUTOSIZE);
+#include <algorithm>
+#include <chrono>
+
+#include "flight_recorder.h"
+#include "opencv2/imgproc.hpp"
+
+namespace {
+// How often the display thread looks for new frames and services GUI events
+constexpr TaskUpdatePeriodMs kDisplayPeriod(8);
+}  // namespace
+
+VideoPlayerDisplay& VideoPlayerDisplay::instance() {
+    static VideoPlayerDisplay display;
+    return display;
 }
 
+VideoPlayerDisplay::VideoPlayerDisplay()
+    : task_(TaskId::VIDEO_PLAYER, TaskPriority::VIDEO_PLAYER, kDisplayPeriod,
+            TaskFcn),
+      stopping_(false) {
+    task_.SetData(this);
+}
+
+void VideoPlayerDisplay::Add(VideoPlayer* player) {
+    std::lock_guard<ProfiledMutex> lifecycle_lock(lifecycle_mutex_);
+    bool start;
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        start = players_.empty();
+        players_.push_back(player);
+        stopping_ = false;
+    }
+    if (start) {
+        task_.Start();
+    }
+}
+
+void VideoPlayerDisplay::Remove(VideoPlayer* player) {
+    std::lock_guard<ProfiledMutex> lifecycle_lock(lifecycle_mutex_);
+    bool stop;
+    {
+        // The display thread presents under this lock, so it is done with the
+        // player once the lock is taken
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        players_.erase(std::remove(players_.begin(), players_.end(), player),
+                       players_.end());
+        if (player->window_open_) {
+            closing_windows_.push_back(player->windowName_);
+        }
+        stop = players_.empty();
+        stopping_ = stop;
+    }
+    if (stop) {
+        cond_.notify_all();
+        task_.Join();
+    }
+}
+
+void VideoPlayerDisplay::TaskFcn(Task* task) {
+    VideoPlayerDisplay* self =
+        static_cast<VideoPlayerDisplay*>(task->GetData());
+
+    while (true) {
+        {
+            std::unique_lock<ProfiledMutex> lock(self->mutex_);
+            self->cond_.wait_for(lock, task->period_ms_,
+                                 [self] { return self->stopping_; });
+            for (auto& window : self->closing_windows_) {
+                cv::destroyWindow(window);
+            }
+            self->closing_windows_.clear();
+            if (self->stopping_) {
+                break;
+            }
+            for (auto* player : self->players_) {
+                if (!player->window_open_) {
+                    cv::namedWindow(player->windowName_, cv::WINDOW_AUTOSIZE);
+                    player->window_open_ = true;
+                }
+                if (player->TakePendingFrame()) {
+                    player->Present();
+                }
+            }
+        }
+        cv::waitKey(1);  // Services GUI events between frames
+    }
+}
+
+VideoPlayer::VideoPlayer(const std::string& windowName,
+                         TaskUpdatePeriodMs display_period,
+                         cv::Size max_display_size)
+    : windowName_(windowName),
+      display_period_(display_period),
+      max_display_size_(max_display_size),
+      frame_pending_(false),
+      window_open_(false),
+      frames_presented_(0),
+      frames_dropped_(0) {
+    VideoPlayerDisplay::instance().Add(this);
+}
+
+VideoPlayer::~VideoPlayer() { VideoPlayerDisplay::instance().Remove(this); }
+
 void VideoPlayer::Consume(const cv::Mat& frame) {
-    cv::imshow(windowName_, frame);
-    cv::waitKey(1);  // Waits for 1 millisecond between frames.
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (frame_pending_) {
+        frames_dropped_++;
+        FlightRecorder::instance().Record("player", "drop", 0, 1.0);
+    }
+    frame.copyTo(pending_frame_);
+    frame_pending_ = true;
+}
+
+void VideoPlayer::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddCounter("Player Frames Presented", frames_presented_);
+    report.AddCounter("Player Frames Dropped", frames_dropped_);
+}
+
+bool VideoPlayer::TakePendingFrame() {
+    // Present at most once per display period; frames that arrive in between
+    // replace each other so the newest one wins
+    if (std::chrono::steady_clock::now() <
+        last_present_time_ + display_period_) {
+        return false;
+    }
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (!frame_pending_) {
+        return false;
+    }
+    // Hand the previously rendered buffer back to Consume() for reuse
+    std::swap(pending_frame_, render_frame_);
+    frame_pending_ = false;
+    return true;
+}
+
+void VideoPlayer::Present() {
+    // Frames from a VideoOutput already fit, since the player asks for its
+    // display size; a graph pipeline sink hands over the full frame
+    auto display_size = FitSize(render_frame_.size(), max_display_size_);
+    if (display_size != render_frame_.size()) {
+        cv::resize(render_frame_, display_frame_, display_size, 0, 0,
+                   cv::INTER_AREA);
+        cv::imshow(windowName_, display_frame_);
+    } else {
+        cv::imshow(windowName_, render_frame_);
+    }
+    last_present_time_ = std::chrono::steady_clock::now();
+    frames_presented_++;
 }
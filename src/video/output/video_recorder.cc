@@ -0,0 +1,195 @@
+/******************************************************************************
+ * Filename:    video_recorder.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "video_recorder.h"
+
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#include "flight_recorder.h"
+#include "logger.h"
+#include "task.h"
+
+namespace fs = std::filesystem;
+
+VideoRecorder::VideoRecorder(const VideoRecorderConfig& config)
+    : config_(config),
+      task_(TaskId::VIDEO_RECORDER, TaskPriority::VIDEO_RECORDER,
+            TaskUpdatePeriodMs(0), TaskFcn),
+      stopping_(false),
+      segment_type_(-1),
+      frames_encoded_(0),
+      frames_dropped_(0),
+      segments_written_(0) {
+    task_.SetData(this);
+    task_.Start();
+}
+
+VideoRecorder::~VideoRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_one();
+    task_.Join();
+}
+
+void VideoRecorder::Consume(const cv::Mat& frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= config_.queue_capacity) {
+        frames_dropped_++;
+        FlightRecorder::instance().Record("recorder", "drop", 0, 1.0,
+                                          "queue full");
+        if (config_.drop_policy == RecorderDropPolicy::DROP_NEWEST) {
+            return;
+        }
+        RecycleBuffer(queue_.front());
+        queue_.pop_front();
+    }
+
+    // Reuse a buffer handed back by the encoder so steady state recording
+    // does not allocate
+    cv::Mat buffer;
+    if (!free_buffers_.empty()) {
+        buffer = free_buffers_.back();
+        free_buffers_.pop_back();
+    }
+    lock.unlock();
+    frame.copyTo(buffer);
+    lock.lock();
+
+    queue_.push_back(buffer);
+    lock.unlock();
+    cond_.notify_one();
+}
+
+void VideoRecorder::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddTimeStatistics("Encode Time", encode_time_stats_.GetStatistics());
+    report.AddCounter("Recorder Frames Encoded", frames_encoded_);
+    report.AddCounter("Recorder Frames Dropped", frames_dropped_);
+    report.AddCounter("Recorder Segments", segments_written_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    report.AddCounter("Recorder Queue Depth", queue_.size());
+}
+
+void VideoRecorder::RecycleBuffer(cv::Mat& buffer) {
+    if (free_buffers_.size() < config_.queue_capacity) {
+        free_buffers_.push_back(buffer);
+    }
+}
+
+bool VideoRecorder::SegmentExpired() const {
+    if (config_.segment_duration.count() == 0) {
+        return false;
+    }
+    return std::chrono::steady_clock::now() - segment_start_ >=
+           config_.segment_duration;
+}
+
+std::string VideoRecorder::SegmentFilename() const {
+    fs::path path(config_.filename);
+    if (config_.segment_duration.count() == 0) {
+        return path.string();
+    }
+
+    auto now = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    std::tm local_time{};
+    localtime_r(&now, &local_time);
+    // Format changes can open several segments within a second
+    std::ostringstream name;
+    name << path.stem().string() << "_"
+         << std::put_time(&local_time, "%Y%m%d_%H%M%S") << "_"
+         << std::setw(4) << std::setfill('0') << segments_written_ + 1
+         << path.extension().string();
+    return (path.parent_path() / name.str()).string();
+}
+
+int VideoRecorder::FourCC() const {
+    if (fs::path(config_.filename).extension() == ".mp4") {
+        return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    }
+    return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+}
+
+void VideoRecorder::OpenSegment(const cv::Mat& frame) {
+    auto filename = SegmentFilename();
+    auto parent = fs::path(filename).parent_path();
+    if (!parent.empty() && !fs::exists(parent)) {
+        fs::create_directories(parent);
+    }
+
+    bool is_color = frame.channels() > 1;
+    if (!writer_.open(filename, FourCC(), config_.fps, frame.size(),
+                      is_color)) {
+        spdlog::error("Failed to open recording segment: {}", filename);
+        return;
+    }
+    spdlog::info("Recording segment: {}", filename);
+    segment_size_ = frame.size();
+    segment_type_ = frame.type();
+    segment_start_ = std::chrono::steady_clock::now();
+    segments_written_++;
+}
+
+void VideoRecorder::CloseSegment() {
+    if (writer_.isOpened()) {
+        writer_.release();
+    }
+}
+
+void VideoRecorder::EncodeFrame(const cv::Mat& frame) {
+    // A writer is bound to one frame geometry, so a change in size or type
+    // (e.g. switching to gray processing) also starts a new segment
+    bool format_changed =
+        frame.size() != segment_size_ || frame.type() != segment_type_;
+    if (!writer_.isOpened() || format_changed || SegmentExpired()) {
+        CloseSegment();
+        OpenSegment(frame);
+    }
+    if (!writer_.isOpened()) {
+        frames_dropped_++;
+        FlightRecorder::instance().Record("recorder", "drop", 0, 1.0,
+                                          "no open segment");
+        return;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    writer_.write(frame);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               end_time - start_time)
+                               .count();
+    auto elapsed_time = static_cast<double>(elapsed_time_ns) * 1.0e-9;
+    encode_time_stats_.Push(elapsed_time);
+    frames_encoded_++;
+}
+
+void VideoRecorder::TaskFcn(Task* task) {
+    VideoRecorder* self = static_cast<VideoRecorder*>(task->GetData());
+
+    while (true) {
+        cv::Mat frame;
+        {
+            std::unique_lock<std::mutex> lock(self->mutex_);
+            self->cond_.wait(lock, [self] {
+                return self->stopping_ || !self->queue_.empty();
+            });
+            if (self->queue_.empty()) {
+                break;
+            }
+            frame = self->queue_.front();
+            self->queue_.pop_front();
+        }
+
+        self->EncodeFrame(frame);
+
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        self->RecycleBuffer(frame);
+    }
+    self->CloseSegment();
+}
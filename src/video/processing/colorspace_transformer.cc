@@ -17,6 +17,26 @@ void BGR2GRAYTransformer::Transform(cv::Mat& frame) {
     }
 }
 
+void BGR2GRAYTransformer::Transform(cv::Mat& frame, FrameViews& views) {
+    // Reuses the gray plane if a detector already derived it for this frame
+    frame = views.Take(PixelFormat::GRAY);
+}
+
 void BGR2HSVTransformer::Transform(cv::Mat& frame) {
     cv::cvtColor(frame, frame, cv::COLOR_BGR2HSV);
 }
+
+void BGR2HSVTransformer::Transform(cv::Mat& frame, FrameViews& views) {
+    frame = views.Take(PixelFormat::HSV);
+}
+
+void FormatConverter::Transform(cv::Mat& frame) {
+    FrameViews views;
+    views.Reset(frame, frame.channels() == 1 ? PixelFormat::GRAY
+                                             : PixelFormat::BGR);
+    Transform(frame, views);
+}
+
+void FormatConverter::Transform(cv::Mat& frame, FrameViews& views) {
+    frame = views.Take(format_);
+}
@@ -12,21 +12,41 @@
 #include "logger.h"
 
 void HaarCascadeClassifier::Transform(cv::Mat& frame) {
+    views_.Reset(frame, frame.channels() == 1 ? PixelFormat::GRAY
+                                              : PixelFormat::BGR);
+    Transform(frame, views_);
+    views_.DrawOverlays(frame);
+    views_.Clear();
+}
+
+void HaarCascadeClassifier::Transform(cv::Mat& frame, FrameViews& views) {
     if (frame.empty()) {
         spdlog::debug("HaarCascadeClassifier: empty frame");
+        return;
     }
 
-    // Load the Haar cascade for face detection
-    cv::CascadeClassifier face_cascade;
-    if (!face_cascade.load(haar_cascades_filename_)) {
-        spdlog::error("Failed to load the Haar cascade!");
+    // Loading a cascade costs more than running it, so it is loaded once
+    if (!cascade_loaded_) {
+        cascade_loaded_ = cascade_.load(haar_cascades_filename_);
+        if (!cascade_loaded_) {
+            spdlog::error("Failed to load the Haar cascade!");
+            return;
+        }
     }
 
+    auto& full = views.View(PixelFormat::GRAY);
+    auto& gray = views.View(PixelFormat::GRAY, detect_size_);
     std::vector<cv::Rect> faces;
-    face_cascade.detectMultiScale(frame, faces, 1.1, 3, 0, cv::Size(30, 30));
+    cascade_.detectMultiScale(gray, faces, 1.1, 3, 0, cv::Size(30, 30));
 
-    // Draw rectangles around the detected faces
+    // Draw rectangles around the detected faces, in full frame coordinates
+    double scale_x = static_cast<double>(full.cols) / gray.cols;
+    double scale_y = static_cast<double>(full.rows) / gray.rows;
     for (size_t i = 0; i < faces.size(); i++) {
-        cv::rectangle(frame, faces[i], cv::Scalar(255, 0, 0), 2);
+        cv::Rect face(static_cast<int>(faces[i].x * scale_x),
+                      static_cast<int>(faces[i].y * scale_y),
+                      static_cast<int>(faces[i].width * scale_x),
+                      static_cast<int>(faces[i].height * scale_y));
+        views.AddOverlay(face, cv::Scalar(255, 0, 0));
     }
 }
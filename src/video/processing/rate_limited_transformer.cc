@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Filename:    rate_limited_transformer.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "rate_limited_transformer.h"
+
+#include "logger.h"
+
+RateLimitedTransformer::RateLimitedTransformer(
+    const RateLimit& limit, std::shared_ptr<VideoTransformer> inner,
+    const std::string& name)
+    : limiter_(limit), inner_(inner), name_(name) {}
+
+void RateLimitedTransformer::Transform(cv::Mat& frame) {
+    views_.Reset(frame, frame.channels() == 1 ? PixelFormat::GRAY
+                                              : PixelFormat::BGR);
+    Transform(frame, views_);
+    views_.DrawOverlays(frame);
+    views_.Clear();
+}
+
+void RateLimitedTransformer::Transform(cv::Mat& frame, FrameViews& views) {
+    if (frame.empty()) {
+        spdlog::debug("RateLimitedTransformer: empty frame");
+        return;
+    }
+
+    if (inner_->IsFormatConversion()) {
+        inner_->Transform(frame, views);
+        return;
+    }
+
+    // Skipped frames still count towards the rate, so the limiter is asked
+    // even when there are no overlays to carry forward yet
+    bool admit = limiter_.Admit();
+    if (!admit && !last_input_size_.empty() &&
+        frame.size() == last_input_size_) {
+        CarryForward(frame, views);
+        return;
+    }
+
+    last_input_size_ = frame.size();
+    auto overlay_count = views.Overlays().size();
+    inner_->Transform(frame, views);
+    auto& overlays = views.Overlays();
+    last_overlays_.assign(overlays.begin() + overlay_count, overlays.end());
+}
+
+void RateLimitedTransformer::CarryForward(cv::Mat& frame, FrameViews& views) {
+    // The inner transformer may end in a conversion, which is cheap next to
+    // the rest of it, so the output format doesn't change on skipped frames
+    auto format = inner_->OutputFormat(views.Format());
+    if (format != views.Format()) {
+        frame = views.Take(format);
+        views.Rebase(frame, format);
+    }
+    for (auto& [rect, color] : last_overlays_) {
+        views.AddOverlay(rect, color);
+    }
+}
+
+void RateLimitedTransformer::ReportDiagnostics(DiagnosticsReport& report) {
+    limiter_.ReportDiagnostics("Rate Limited " + name_, report);
+    inner_->ReportDiagnostics(report);
+}
+
+std::shared_ptr<VideoTransformer> RateLimitedTransformerFactory::Create() {
+    auto inner = inner_->Create();
+    if (!inner) {
+        return nullptr;
+    }
+    return std::make_shared<RateLimitedTransformer>(limit_, inner, name_);
+}
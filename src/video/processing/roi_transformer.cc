@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Filename:    roi_transformer.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "roi_transformer.h"
+
+#include "logger.h"
+
+RoiTransformer::RoiTransformer(std::vector<cv::Rect> regions,
+                               std::shared_ptr<VideoTransformer> inner)
+    : regions_(std::move(regions)),
+      inner_(inner),
+      region_views_(regions_.size()) {}
+
+void RoiTransformer::Transform(cv::Mat& frame) {
+    views_.Reset(frame, frame.channels() == 1 ? PixelFormat::GRAY
+                                              : PixelFormat::BGR);
+    Transform(frame, views_);
+    views_.DrawOverlays(frame);
+    views_.Clear();
+}
+
+const cv::Mat& RoiTransformer::RegionSource(FrameViews& views,
+                                            PixelFormat& format) {
+    format = views.Format();
+    if (!IsYuv420(format)) {
+        return views.View(format);
+    }
+    // Regions of a YUV frame are cut from the Y plane, which is all a
+    // detector needs. A transformer that changes pixels is never handed a
+    // YUV frame.
+    auto input_format = inner_->InputFormat();
+    format = input_format == PixelFormat::ANY ? PixelFormat::GRAY
+                                              : input_format;
+    return views.View(format);
+}
+
+void RoiTransformer::Transform(cv::Mat& frame, FrameViews& views) {
+    if (frame.empty()) {
+        spdlog::debug("RoiTransformer: empty frame");
+        return;
+    }
+
+    PixelFormat format;
+    auto& source = RegionSource(views, format);
+    auto bounds = cv::Rect(0, 0, source.cols, source.rows);
+    bool modifies_frame = inner_->ModifiesFrame();
+    if (modifies_frame) {
+        views.DrawOverlays(frame);
+    }
+    for (std::size_t i = 0; i < regions_.size(); i++) {
+        auto rect = regions_[i] & bounds;
+        if (rect.empty()) {
+            continue;
+        }
+        auto& region_views = region_views_[i];
+        cv::Mat region = source(rect);
+        auto region_data = region.data;
+        region_views.Reset(region, format);
+        inner_->Transform(region, region_views);
+
+        if (modifies_frame && (region.data != region_data ||
+                               region.size() != rect.size() ||
+                               region.type() != source.type())) {
+            // The region came back in a new buffer, possibly in another
+            // format
+            cv::Mat target = source(rect);
+            result_views_.Reset(region, inner_->OutputFormat(format));
+            result_views_.View(format).copyTo(target);
+            result_views_.Clear();
+        }
+        region_views.MoveOverlays(views, rect.tl());
+        region_views.Clear();
+    }
+    if (modifies_frame) {
+        views.Rebase(frame, views.Format());
+    }
+}
+
+void RoiTransformer::ReportDiagnostics(DiagnosticsReport& report) {
+    inner_->ReportDiagnostics(report);
+}
+
+std::shared_ptr<VideoTransformer> RoiTransformerFactory::Create() {
+    auto inner = inner_->Create();
+    if (!inner) {
+        return nullptr;
+    }
+    return std::make_shared<RoiTransformer>(regions_, inner);
+}
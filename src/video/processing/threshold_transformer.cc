@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Filename:    threshold_transformer.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "threshold_transformer.h"
+
+#include "logger.h"
+#include "opencv2/imgproc.hpp"
+
+ThresholdTransformer::ThresholdTransformer(float level, float gain)
+    : level_(level),
+      gain_(gain),
+      unfused_logged_(false),
+      color_kernel_(BgrToGrayOp{}, GainOp{gain, 0.0f},
+                    ThresholdOp{level, 255.0f}),
+      gray_kernel_(GainOp{gain, 0.0f}, ThresholdOp{level, 255.0f}) {}
+
+void ThresholdTransformer::Transform(cv::Mat& frame) {
+    // The mask is handed downstream with the frame, so it can't be reused
+    cv::Mat mask;
+    bool fused = frame.channels() == 1 ? gray_kernel_.Run(frame, mask)
+                                       : color_kernel_.Run(frame, mask);
+    if (!fused) {
+        if (!unfused_logged_) {
+            spdlog::warn(
+                "Thresholding {} channel frames of depth {} without the fused "
+                "kernel",
+                frame.channels(), frame.depth());
+            unfused_logged_ = true;
+        }
+        if (!ThresholdUnfused(frame, mask)) {
+            spdlog::error(
+                "Can't threshold a {} channel frame, leaving it as is",
+                frame.channels());
+            return;
+        }
+    }
+    frame = mask;
+}
+
+bool ThresholdTransformer::ThresholdUnfused(const cv::Mat& frame,
+                                            cv::Mat& mask) const {
+    cv::Mat gray;
+    switch (frame.channels()) {
+        case 1:
+            gray = frame;
+            break;
+        case 3:
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            break;
+        case 4:
+            cv::cvtColor(frame, gray, cv::COLOR_BGRA2GRAY);
+            break;
+        default:
+            return false;
+    }
+    gray.convertTo(gray, CV_32F, gain_);
+    cv::threshold(gray, gray, level_, 255.0, cv::THRESH_BINARY);
+    gray.convertTo(mask, CV_8U);
+    return true;
+}
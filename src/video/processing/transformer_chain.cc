@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Filename:    transformer_chain.cc
+ * Copyright (c) 2023 Keaton Scheible
+ *****************************************************************************/
+
+#include "transformer_chain.h"
+
+#include <chrono>
+
+#include "colorspace_transformer.h"
+#include "logger.h"
+
+void TransformerChain::Append(const std::string& name,
+                              std::shared_ptr<VideoTransformer> transformer) {
+    if (transformer->IsFormatConversion() &&
+        transformer->OutputFormat(output_format_) == output_format_) {
+        spdlog::info("Chain link {} elided, the frame is already {}", name,
+                     PixelFormatName(output_format_));
+        return;
+    }
+
+    auto input_format = transformer->InputFormat();
+    if (!transformer->IsFormatConversion() &&
+        input_format != PixelFormat::ANY && input_format != output_format_) {
+        auto converter_name =
+            std::string("to ") + PixelFormatName(input_format);
+        spdlog::info("Chain inserted a conversion to {} before {}",
+                     PixelFormatName(input_format), name);
+        AppendLink(converter_name,
+                   std::make_shared<FormatConverter>(input_format));
+    }
+    AppendLink(name, transformer);
+}
+
+void TransformerChain::AppendLink(
+    const std::string& name, std::shared_ptr<VideoTransformer> transformer) {
+    Link link;
+    link.name = name;
+    link.transformer = transformer;
+    link.output_format = transformer->OutputFormat(output_format_);
+    link.time_stats = std::make_unique<StatisticsQueue<double>>(100);
+    output_format_ = link.output_format;
+    links_.push_back(std::move(link));
+}
+
+void TransformerChain::Transform(cv::Mat& frame) {
+    views_.Reset(frame, input_format_);
+    Transform(frame, views_);
+    views_.DrawOverlays(frame);
+    views_.Clear();
+}
+
+void TransformerChain::Transform(cv::Mat& frame, FrameViews& views) {
+    for (auto& link : links_) {
+        if (frame.empty()) {
+            spdlog::debug("TransformerChain: empty frame before {}",
+                          link.name);
+            return;
+        }
+        bool modifies_frame = link.transformer->ModifiesFrame();
+        bool is_conversion = link.transformer->IsFormatConversion();
+        // A conversion keeps the geometry, so overlays can wait for the
+        // first link that changes pixels, or for the caller
+        if (modifies_frame && !is_conversion) {
+            views.DrawOverlays(frame);
+        }
+        auto start_time = std::chrono::high_resolution_clock::now();
+        link.transformer->Transform(frame, views);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed_time_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                                 start_time)
+                .count();
+        link.time_stats->Push(static_cast<double>(elapsed_time_ns) * 1.0e-9);
+        // Overlays pending at this point were added by the link itself, e.g.
+        // a region of interest stage, and still apply
+        if (modifies_frame) {
+            views.Rebase(frame, link.output_format);
+        }
+    }
+}
+
+PixelFormat TransformerChain::OutputFormat(PixelFormat input) const {
+    auto format = input;
+    for (auto& link : links_) {
+        format = link.transformer->OutputFormat(format);
+    }
+    return format;
+}
+
+bool TransformerChain::ModifiesFrame() const {
+    for (auto& link : links_) {
+        if (link.transformer->ModifiesFrame() &&
+            !link.transformer->IsFormatConversion()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformerChain::ReportDiagnostics(DiagnosticsReport& report) {
+    report.AddCounter("Chain Format Conversions", views_.Conversions());
+    for (std::size_t i = 0; i < links_.size(); i++) {
+        auto& link = links_[i];
+        auto prefix = "Link " + std::to_string(i + 1) + " " + link.name;
+        report.AddTimeStatistics(prefix, link.time_stats->GetStatistics());
+
+        DiagnosticsReport link_report;
+        link.transformer->ReportDiagnostics(link_report);
+        for (auto& [name, statistics] : link_report.time_statistics) {
+            report.AddTimeStatistics(prefix + " " + name, statistics);
+        }
+        for (auto& [name, value] : link_report.counters) {
+            report.AddCounter(prefix + " " + name, value);
+        }
+        for (auto& [name, value] : link_report.values) {
+            report.AddValue(prefix + " " + name, value);
+        }
+    }
+}
+
+std::shared_ptr<VideoTransformer> TransformerChainFactory::Create() {
+    auto chain = std::make_shared<TransformerChain>();
+    for (auto& [name, factory] : links_) {
+        auto transformer = factory->Create();
+        if (!transformer) {
+            spdlog::error("Failed to create chain link {}", name);
+            return nullptr;
+        }
+        chain->Append(name, transformer);
+    }
+    return chain;
+}
@@ -9,9 +9,11 @@
 #include <iostream>
 #include <mutex>
 
+#include "flight_recorder.h"
 #include "logger.h"
 #include "opencv2/core.hpp"
 #include "task.h"
+#include "trace.h"
 #include "video_task.h"
 
 VideoProcessor::VideoProcessor(
@@ -34,25 +36,82 @@ void VideoProcessor::Stop() { running_ = false; }
 
 void VideoProcessor::ChangeTransformer(
     std::shared_ptr<VideoTransformerFactory> new_transformer_factory) {
+    auto transformer = new_transformer_factory->Create();
+    if (!transformer) {
+        return;
+    }
+    std::lock_guard<ProfiledMutex> lock(transformer_mutex_);
     transformer_factory_ = new_transformer_factory;
-    transformer_ = transformer_factory_->Create();
+    transformer_ = transformer;
+    FlightRecorder::instance().Record("processing", "transformer swap", 0,
+                                      0.0);
 }
 
-void VideoProcessor::GetInputFrame(cv::Mat& frame) {
-    std::unique_lock<std::mutex> lock(input_.mutex_);
+void VideoProcessor::ReportDiagnostics(DiagnosticsReport& report) {
+    std::lock_guard<ProfiledMutex> lock(transformer_mutex_);
+    transformer_->ReportDiagnostics(report);
+}
+
+void VideoProcessor::GetInputFrame(Frame& frame) {
+    std::unique_lock<ProfiledMutex> lock(input_.mutex_);
     input_.cond_.wait(lock);
     input_.GetOutputFrame(frame);
 }
 
-void VideoProcessor::ProcessFrame(cv::Mat& frame) {
+void VideoProcessor::ProcessFrame(Frame& frame) {
+    std::shared_ptr<VideoTransformer> transformer;
+    {
+        std::lock_guard<ProfiledMutex> lock(transformer_mutex_);
+        transformer = transformer_;
+    }
+    auto frame_id = frame.Id();
+    auto capture_time = frame.CaptureTime();
+    TraceSpan span("process", frame_id);
+    perf_counters_.Begin();
     auto start_time = std::chrono::high_resolution_clock::now();
-    transformer_->Transform(frame);
+    auto format = frame.Format();
+    if (transformer->ModifiesFrame() && !transformer->IsFormatConversion()) {
+        if (IsYuv420(format)) {
+            views_.Reset(frame.Read(), format);
+            frame = frame_pool_->Adopt(views_.Take(PixelFormat::BGR));
+            views_.Clear();
+            format = PixelFormat::BGR;
+        }
+        transformer->Transform(frame.Write());
+        frame.SetFormat(transformer->OutputFormat(format));
+    } else {
+        // Detectors and conversions only read the shared input frame, so it
+        // is copied only if there are detections to draw
+        cv::Mat image = frame.Read();
+        views_.Reset(image, format);
+        transformer->Transform(image, views_);
+        // The gray view of a YUV frame starts at the same address, so the
+        // geometry has to be compared as well
+        auto& input = frame.Read();
+        if (image.data != input.data || image.size() != input.size() ||
+            image.type() != input.type()) {
+            frame = frame_pool_->Adopt(image,
+                                       transformer->OutputFormat(format));
+        }
+        image.release();
+        if (views_.HasOverlays()) {
+            views_.DrawOverlays(frame.Write());
+        }
+        views_.Clear();
+    }
+    // Conversions and copies hand back new frames
+    frame.SetId(frame_id);
+    frame.SetCaptureTime(capture_time);
+    perf_counters_.End();
     auto end_time = std::chrono::high_resolution_clock::now();
     auto elapsed_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
                                end_time - start_time)
                                .count();
     auto elapsed_time = static_cast<double>(elapsed_time_ns) * 1.0e-9;
     time_stats_.Push(elapsed_time);
+    time_histogram_->Observe(elapsed_time);
+    FlightRecorder::instance().RecordFrame("processing", frame_id,
+                                           elapsed_time);
 }
 
 void VideoProcessor::TaskFcn(Task* task) {
@@ -60,11 +119,15 @@ void VideoProcessor::TaskFcn(Task* task) {
 
     while (!self->shutting_down_) {
         if (self->running_) {
-            cv::Mat& frame = self->next_buffer_;
-            self->GetInputFrame(frame);
+            Frame frame;
+            {
+                TraceSpan span("wait for frame");
+                self->GetInputFrame(frame);
+                span.SetFrame(frame.Id());
+            }
             if (!frame.empty()) {
                 self->ProcessFrame(frame);
-                self->SwapBuffers();
+                self->Publish(std::move(frame));
                 self->NotifyListeners();
             } else {
                 spdlog::error("Processor received an empty frame.");
@@ -8,14 +8,20 @@
 #include <atomic>
 
 #include "task.h"
+#include "trace.h"
 
 VideoTask::VideoTask(TaskId id, TaskPriority priority,
                      TaskUpdatePeriodMs period_ms, TaskFunction function,
                      std::atomic<bool>& shutting_down)
-    : task_(id, priority, period_ms, function),
+    : mutex_(TaskName(id)),
+      cond_(TaskName(id)),
+      task_(id, priority, period_ms, function),
       shutting_down_(shutting_down),
-      current_buffer_(buffer1_),
-      next_buffer_(buffer2_) {}
+      frame_pool_(std::make_shared<FramePool>()),
+      frames_total_(MetricsRegistry::instance().GetCounter(
+          std::string(TaskName(id)) + "_frames_total")),
+      time_histogram_(MetricsRegistry::instance().GetHistogram(
+          std::string(TaskName(id)) + "_time_seconds")) {}
 
 VideoTask::~VideoTask() {}
 
@@ -23,16 +29,31 @@ void VideoTask::Init() { task_.Start(); }
 
 void VideoTask::Shutdown() { task_.Join(); }
 
-void VideoTask::GetOutputFrame(cv::Mat& frame) { frame = current_buffer_; }
+void VideoTask::GetOutputFrame(Frame& frame) { frame = current_frame_; }
 
-void VideoTask::SwapBuffers() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::swap(current_buffer_, next_buffer_);
+void VideoTask::ReportFrameDiagnostics(const std::string& prefix,
+                                       DiagnosticsReport& report) {
+    frame_pool_->ReportDiagnostics(prefix, report);
+}
+
+void VideoTask::ReportPerfDiagnostics(const std::string& prefix,
+                                      DiagnosticsReport& report) {
+    perf_counters_.ReportDiagnostics(prefix, report);
+}
+
+void VideoTask::Publish(Frame frame) {
+    TraceSpan span("publish", frame.Id());
+    // The previous frame goes back to the pool once its readers are done
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        current_frame_ = std::move(frame);
+    }
+    frames_total_->Add();
 }
 
 void VideoTask::NotifyListeners() { cond_.notify_one(); }
 
 void VideoTask::Throttle() {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<ProfiledMutex> lock(mutex_);
     cond_.wait_for(lock, task_.period_ms_);
 }